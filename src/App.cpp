@@ -1,5 +1,6 @@
 #include "App.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -7,84 +8,531 @@
 #include <errno.h>
 #include <cstring>
 #include <chrono>
-
-#include "lodepng.h"
+#include <cmath>
+#include <thread>
 
 #include "Result.h"
 #include "MathUtil.h"
 
-#define IMG_UNIT 0
-#define IMG_UNIT_GL GL_TEXTURE0
+#define LAST_OUTPUT_UNIT 0
+#define LAST_OUTPUT_UNIT_GL GL_TEXTURE0
+
+// Units from here on are handed out in order: imgN, capN, seq0, then each pass's inputs
+#define FIRST_INPUT_UNIT 1
 
-#define WEBCAM_UNIT 1
-#define WEBCAM_UNIT_GL GL_TEXTURE1
+#define MAX_CAPTURES 8
 
-#define LAST_OUTPUT_UNIT 2
-#define LAST_OUTPUT_UNIT_GL GL_TEXTURE2
+#define JOYSTICK_BINDING 0
 
-#define SRC 0
-#define DEST 1
+// Every pass draws here, and the output is left attached for the blit and readbacks
+#define OUTPUT_ATTACHMENT GL_COLOR_ATTACHMENT0
 
 App::App(const std::filesystem::path& out_dir, Size resolution, int repeat)
-    : img_(new Image()), out_dir_(out_dir), resolution_(resolution), repeat_(repeat)  {}
+    : out_dir_(out_dir), resolution_(resolution), repeat_(repeat)  {
+    phases_.render = profiler_.addPhase("render");
+    phases_.joystick_update = profiler_.addPhase("joystick_update");
+    phases_.shader_update = profiler_.addPhase("shader_update");
+    phases_.webcam_read = profiler_.addPhase("webcam_read");
+    phases_.webcam_upload = profiler_.addPhase("webcam_upload");
+    phases_.sequence_upload = profiler_.addPhase("sequence_upload");
+    phases_.image_reload = profiler_.addPhase("image_reload");
+    phases_.uniforms = profiler_.addPhase("uniforms");
+    phases_.iteration = profiler_.addPhase("iteration");
+    phases_.blit = profiler_.addPhase("blit");
+}
 
-Error App::screenshot() {
+Profiler& App::getProfiler() {
+    return profiler_;
+}
+
+void App::setJoystickUBO(bool enabled) {
+    joystick_ubo_ = enabled;
+}
+
+void App::setWebcamSettings(const WebcamSettings& settings) {
+    webcam_settings_ = settings;
+}
+
+void App::setVideoSettings(const VideoSettings& settings) {
+    video_settings_ = settings;
+}
+
+void App::setCacheDir(const std::filesystem::path& dir) {
+    if (dir.empty()) {
+        image_cache_.reset();
+        program_cache_.reset();
+    } else {
+        image_cache_ = std::make_unique<ImageCache>(dir);
+        program_cache_ = std::make_shared<ProgramCache>(dir);
+    }
+}
+
+void App::setCompileContext(std::unique_ptr<SharedContext> context) {
+    compile_context_ = std::move(context);
+}
+
+void App::setPipeline(const std::filesystem::path& path) {
+    pipeline_path_ = path;
+}
+
+void App::setTargetFrameTime(double ms) {
+    target_ms_ = ms;
+}
+
+void App::setSequence(const std::filesystem::path& dir, double fps, size_t budget_bytes) {
+    seq_dir_ = dir;
+    seq_fps_ = fps;
+    seq_budget_ = budget_bytes;
+}
+
+Error App::addSource(Capture cap) {
+    if (captures_.size() >= MAX_CAPTURES) {
+        return "at most " + std::to_string(MAX_CAPTURES) + " capture sources are supported";
+    }
+
+    cap.tex = std::make_unique<StreamTexture>();
+    captures_.push_back(std::move(cap));
+
+    return {};
+}
+
+Error App::addCapture(int device) {
+    Capture cap;
+    cap.device = device;
+    return addSource(std::move(cap));
+}
+
+Error App::addVideo(const std::filesystem::path& path) {
+    Capture cap;
+    cap.video_path = path;
+    return addSource(std::move(cap));
+}
+
+void App::setCaptureBudget(size_t bytes) {
+    capture_budget_ = bytes;
+}
+
+std::string App::timestampName() {
     std::stringstream s;
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
     std::time_t now = std::time(nullptr);
-    s << "output-" << std::put_time(std::localtime(&now), "%Y-%m-%d_") << ms << ".png";
-    std::filesystem::path dest = out_dir_ / s.str();
+    s << "output-" << std::put_time(std::localtime(&now), "%Y-%m-%d_") << ms;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
-    int width = resolution_.getWidth<int>();
-    int height = resolution_.getHeight<int>();;
-    unsigned pixels = resolution_.getWidth<unsigned int>() * resolution_.getHeight<unsigned int>();
-    std::vector<unsigned char> image(pixels * 4);
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+    return s.str();
+}
+
+Error App::screenshot() {
+    return writeOutput(out_dir_ / (timestampName() + ".png"));
+}
+
+Error App::writeOutput(const std::filesystem::path& dest) {
+    // The governor may have the output smaller than resolution_
+    GLsizei width = passes_[output_pass_].size.getWidth<GLsizei>();
+    GLsizei height = passes_[output_pass_].size.getHeight<GLsizei>();
+
+    // Copy out of the mapped buffer and let the writer thread flip and encode. The
+    // render loop never waits on the encoder, a screenshot it can't take is dropped.
+    auto done = [this, dest, width, height](const unsigned char* pixels) {
+        bool queued = image_writer_.tryWrite(
+            dest,
+            pixels,
+            static_cast<unsigned int>(width),
+            static_cast<unsigned int>(height));
+        if (!queued) {
+            std::cerr << "Unable to save " << dest.string() << ": too many screenshots still being written" << std::endl;
+        }
+    };
 
-    // Flip upside down (PNG's coordinate system is upside down to OpenGL's)
-    std::vector<unsigned char> flipped;
-    for (int row = height - 1; row >= 0; row--) {
-        int offset = row * (width * 4);
-        flipped.insert(flipped.end(), image.begin() + offset, image.begin() + offset + (width * 4));
+    if (!readback_.request(fbo_, OUTPUT_ATTACHMENT, width, height, done)) {
+        return "too many captures still in flight";
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return {};
+}
+
+void App::finishOutput() {
+    for (size_t i = 0; i < captures_.size(); i++) {
+        const Capture& cap = captures_[i];
+        if (cap.video) {
+            VideoSource::Stats stats = cap.video->getStats();
+            std::cerr << "cap" << i << " (" << cap.video_path.filename().string() << "): "
+                << stats.decoded << " frames decoded, " << stats.skipped << " skipped"
+                << ", " << stats.seeks << " seeks" << std::endl;
+        }
+
+        if (!cap.webcam) {
+            continue;
+        }
+
+        Webcam::Stats stats = cap.webcam->getStats();
+        if (stats.frames > 0) {
+            double frames = static_cast<double>(stats.frames);
+            double mean_interval = stats.frames > 1 ? stats.interval_ms_total / (frames - 1) : 0;
+            std::cerr << "cap" << i << " (device " << cap.device << "): " << stats.frames << " frames"
+                << ", mean interval " << mean_interval << " ms"
+                << " (max " << stats.interval_ms_max << " ms)"
+                << ", mean wait " << stats.grab_ms_total / frames << " ms"
+                << ", mean decode " << stats.retrieve_ms_total / frames << " ms"
+                << ", " << stats.failures << " failed reads" << std::endl;
+        }
+    }
+
+    readback_.flush();
+    image_writer_.wait();
+    capture_readback_.flush();
 
-    unsigned errc = lodepng::encode(
-        dest,
-        flipped,
+    if (recorder_) {
+        recorder_->close();
+        std::cerr << "Recorded " << recorder_->getWritten() << " frames, dropped " << recorder_->getDropped() << std::endl;
+        recorder_.reset();
+    }
+
+    if (sequence_writer_) {
+        sequence_writer_->wait();
+        std::cerr << "Wrote " << sequence_writer_->getWritten() << " PNG frames with "
+            << sequence_writer_->getThreadCount() << " encoders at "
+            << sequence_writer_->getThroughput() << " frames/s" << std::endl;
+        sequence_writer_.reset();
+    }
+}
+
+Error App::startRecording(const std::string& path, PipeRecorder::Format format, unsigned int fps, bool lossless) {
+    recorder_ = std::make_unique<PipeRecorder>();
+    record_lossless_ = lossless;
+
+    Error err = recorder_->open(
+        path,
+        format,
         resolution_.getWidth<unsigned int>(),
-        resolution_.getHeight<unsigned int>()
-    );
-    if (errc) {
-        return "encoder error " + std::to_string(errc) + ": "+ lodepng_error_text(errc);
+        resolution_.getHeight<unsigned int>(),
+        fps,
+        lossless);
+    if (err) {
+        recorder_.reset();
+    }
+
+    return err;
+}
+
+void App::startSequence(const std::string& prefix, size_t encoders) {
+    // A couple of frames queued per encoder keeps them all busy without hoarding memory
+    sequence_writer_ = std::make_unique<ImageWriter>(encoders, encoders * 2);
+    sequence_prefix_ = prefix;
+    sequence_frame_ = 0;
+}
+
+void App::captureFrame() {
+    GLsizei width = resolution_.getWidth<GLsizei>();
+    GLsizei height = resolution_.getHeight<GLsizei>();
+
+    // Numbered when requested, so names follow render order however the encoders finish
+    std::filesystem::path sequence_dest;
+    if (sequence_writer_) {
+        std::ostringstream name;
+        name << sequence_prefix_ << std::setfill('0') << std::setw(6) << sequence_frame_++ << ".png";
+        sequence_dest = out_dir_ / name.str();
+    }
+
+    // One read feeds both the pipe and the PNG sequence
+    auto done = [this, sequence_dest, width, height](const unsigned char* pixels) {
+        if (recorder_) {
+            recorder_->push(pixels);
+        }
+
+        if (sequence_writer_) {
+            size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+            sequence_writer_->write(
+                sequence_dest,
+                std::vector<unsigned char>(pixels, pixels + size),
+                static_cast<unsigned int>(width),
+                static_cast<unsigned int>(height));
+        }
+    };
+
+    if (capture_readback_.request(fbo_, OUTPUT_ATTACHMENT, width, height, done)) {
+        return;
+    }
+
+    // Every buffer is still in flight. The PNG sequence never skips a frame and a
+    // lossless recording waits its turn too, only a live recording drops.
+    if (sequence_writer_ || record_lossless_) {
+        capture_readback_.flush();
+        capture_readback_.request(fbo_, OUTPUT_ATTACHMENT, width, height, done);
+    } else {
+        recorder_->drop();
+    }
+}
+
+bool App::setupCapture(Capture& cap) {
+    std::string err;
+    if (!cap.video_path.empty()) {
+        if (!cap.video) {
+            cap.video = std::make_unique<VideoSource>(cap.video_path, video_settings_);
+        }
+        err = cap.video->startIf().value_or("");
+    } else {
+        if (!cap.webcam) {
+            cap.webcam = std::make_unique<Webcam>(cap.device, webcam_settings_);
+        }
+        err = cap.webcam->startIf().value_or("");
+    }
+
+    // We're called every frame, so only mention a failure once until it changes
+    if (err != cap.last_err) {
+        if (err != "") {
+            std::cerr << "Error opening capture source: " << err << std::endl;
+        }
+        cap.last_err = err;
     }
 
+    return err == "";
+}
+
+void App::updateCaptures(double t) {
+    if (captures_.empty()) {
+        return;
+    }
+
+    // Each source has its own capture thread, but uploads share the frame. Once the
+    // budget is spent the remaining sources keep their newest frame for next time,
+    // and the first source considered rotates so a tight budget still serves them all.
+    size_t spent = 0;
+    bool uploaded = false;
+    for (size_t n = 0; n < captures_.size(); n++) {
+        size_t idx = (next_capture_ + n) % captures_.size();
+        Capture& cap = captures_[idx];
+
+        bool sampled = isActive(cap.sampler);
+        cap.open = (sampled || isActive(cap.resolution)) && setupCapture(cap);
+        if (!cap.open) {
+            continue;
+        }
+
+        // Only its resolution is used, so frames are still taken to keep the size
+        // current but there's nothing to upload and nothing spent from the budget
+        if (!sampled) {
+            profiler_.start(phases_.webcam_read);
+            if (cap.video) {
+                cap.video->read(t);
+            } else {
+                cap.webcam->read();
+            }
+            profiler_.stop(phases_.webcam_read);
+            continue;
+        }
+
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + cap.unit));
+
+        // Judged by the last frame's size, reading the new one would consume it
+        size_t cost = static_cast<size_t>(cap.tex->getWidth()) * static_cast<size_t>(cap.tex->getHeight()) * 3;
+        if (capture_budget_ == 0 || !uploaded || spent + cost <= capture_budget_) {
+            profiler_.start(phases_.webcam_read);
+            const cv::Mat* frame = cap.video ? cap.video->read(t) : cap.webcam->read();
+            profiler_.stop(phases_.webcam_read);
+
+            if (frame) {
+                // Already flipped by the capture thread, and GL swizzles BGR for free
+                cv::Size size = frame->size();
+                cap.tex->upload(frame->data, size.width, size.height, GL_BGR);
+                spent += frame->total() * frame->elemSize();
+                uploaded = true;
+            }
+        }
+    }
+
+    next_capture_ = (next_capture_ + 1) % captures_.size();
+}
+
+Error App::loadImages(const std::vector<std::filesystem::path>& paths) {
+    if (paths.empty()) {
+        return {};
+    }
+
+    // Buffers are mapped up front on this thread. Decoding is the slow part and
+    // needs no GL, so every image decodes into its buffer at once while this
+    // thread uploads each as soon as it's ready, in order.
+    for (size_t i = 0; i < paths.size(); i++) {
+        imgs_[i].path = paths[i];
+        image_watcher_.watch(paths[i]);
+
+        Error err = imgs_[i].image->prepare(paths[i], image_cache_.get());
+        if (err) {
+            return "Error loading " + paths[i].string() + ": " + err.value();
+        }
+    }
+
+    size_t threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), paths.size());
+    ThreadPool pool(threads, paths.size());
+
+    std::vector<std::future<Error>> loads;
+    for (size_t i = 0; i < paths.size(); i++) {
+        auto task = std::make_shared<std::packaged_task<Error()>>(
+            [img = imgs_[i].image.get()]() { return img->decode(); });
+        loads.push_back(task->get_future());
+        pool.submit([task]() { (*task)(); });
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        Error err = loads[i].get();
+        if (err) {
+            // The pool finishes the rest before it goes away, nothing is left decoding into imgs_
+            return "Error loading " + paths[i].string() + ": " + err.value();
+        }
+
+        imgs_[i].image->upload();
+    }
+
+    size_t cached = 0;
+    for (const auto& img : imgs_) {
+        cached += img.image->isCached() ? 1 : 0;
+    }
+    std::cerr << "Loaded " << imgs_.size() << " images, " << cached << " from the cache" << std::endl;
+
+    // A couple of threads, for when several files are saved at once
+    reload_pool_ = std::make_unique<ThreadPool>(std::min<size_t>(threads, 2), imgs_.size());
+
     return {};
 }
 
-bool App::setupWebcam(int dev) {
-    if (!webcam_) {
-        webcam_ = std::make_unique<Webcam>(dev);
+void App::reloadImages() {
+    // Start decoding whatever changed, unless it's still decoding the last change
+    for (const auto& path : image_watcher_.poll()) {
+        for (auto& img : imgs_) {
+            if (img.path != path || img.reload.valid()) {
+                continue;
+            }
+
+            Error err = img.image->prepare(path, image_cache_.get());
+            if (err) {
+                std::cerr << "Error reloading " << path.string() << ": " << err.value() << std::endl;
+                continue;
+            }
+
+            auto task = std::make_shared<std::packaged_task<Error()>>(
+                [image = img.image.get()]() { return image->decode(); });
+            img.reload = task->get_future();
+            reload_pool_->submit([task]() { (*task)(); });
+        }
     }
 
-    Error err = webcam_->startIf();
-    if (err) {
-        std::cerr << "Error opening webcam: " << err.value() << std::endl;
-        return false;
+    // Swap in what's finished, the old pixels stay up until then
+    for (auto& img : imgs_) {
+        if (!img.reload.valid() || img.reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+
+        Error err = img.reload.get();
+        if (err) {
+            std::cerr << "Error reloading " << img.path.string() << ": " << err.value() << std::endl;
+            img.image->cancel();
+            continue;
+        }
+
+        // Upload on the image's own unit, it's rebound there every frame anyway
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + img.unit));
+        img.image->upload();
+        std::cerr << "Reloaded " << img.path.string() << std::endl;
+    }
+}
+
+Error App::assignTextureUnits() {
+    GLint unit = FIRST_INPUT_UNIT;
+    for (auto& img : imgs_) {
+        img.unit = unit++;
+    }
+
+    for (auto& cap : captures_) {
+        cap.unit = unit++;
+    }
+
+    if (seq_) {
+        seq_unit_ = unit++;
+    }
+
+    // Passes draw one at a time, so they can all use the same units for what they read from each other
+    first_pass_unit_ = unit;
+    for (auto& pass : passes_) {
+        GLint pass_unit = first_pass_unit_;
+        for (auto& input : pass.inputs) {
+            if (input.kind == Pipeline::Input::Kind::Image) {
+                input.unit = imgs_[input.index].unit;
+            } else if (input.kind == Pipeline::Input::Kind::Capture) {
+                input.unit = captures_[input.index].unit;
+            } else {
+                input.unit = pass_unit++;
+            }
+        }
+        unit = std::max(unit, pass_unit);
+    }
+
+    GLint max_units = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &max_units);
+    if (unit > max_units) {
+        return "Too many inputs, they need " + std::to_string(unit) + " texture units and the GPU has "
+            + std::to_string(max_units);
     }
 
-    return true;
+    return {};
+}
+
+// Called for every pass, always adding the same names in the same order, so
+// each of these slots is the same in every pass's registry
+void App::registerUniforms(UniformRegistry& uniforms) {
+
+    uniforms_.seq0 = uniforms.add("seq0");
+    uniforms_.seq0_layer = uniforms.add("seq0Layer");
+    uniforms_.seq0_frame = uniforms.add("seq0Frame");
+    uniforms_.seq0_frames = uniforms.add("seq0Frames");
+    uniforms_.res_seq0 = uniforms.add("iResolutionSeq0");
+    uniforms_.resolution = uniforms.add("iResolution");
+    uniforms_.time = uniforms.add("iTime");
+    uniforms_.iteration = uniforms.add("iteration");
+    uniforms_.last_out = uniforms.add("lastOut");
+    uniforms_.first_pass = uniforms.add("firstPass");
+
+    for (size_t i = 0; i < imgs_.size(); i++) {
+        imgs_[i].sampler = uniforms.add("img" + std::to_string(i));
+        imgs_[i].resolution = uniforms.add("iResolutionImg" + std::to_string(i));
+    }
+
+    for (size_t i = 0; i < captures_.size(); i++) {
+        captures_[i].sampler = uniforms.add("cap" + std::to_string(i));
+        captures_[i].resolution = uniforms.add("iResolutionCap" + std::to_string(i));
+    }
+
+    // With the uniform buffer, joystick state goes through the generated header instead
+    joystick_uniforms_.clear();
+    if (joystick_ubo_) {
+        return;
+    }
+
+    int joy_idx = 1;
+    for (const auto& joy : joysticks_) {
+        std::vector<JoystickUniforms> slots;
+        for (const auto& kv : joy->getOutputs()) {
+            const std::string base = "j" + std::to_string(joy_idx) + kv.first;
+
+            JoystickUniforms joy_slots;
+            joy_slots.value = uniforms.add(base);
+            joy_slots.pressed = uniforms.add(base + "Pressed");
+            joy_slots.pressed_new = uniforms.add(base + "PressedNew");
+            joy_slots.time = uniforms.add(base + "Time");
+            joy_slots.time_total = uniforms.add(base + "TimeTotal");
+            slots.push_back(joy_slots);
+        }
+
+        joystick_uniforms_.push_back(slots);
+        joy_idx++;
+    }
 }
 
 std::optional<std::string> App::setup(
         std::filesystem::path vert_path,
         std::filesystem::path frag_path,
         std::vector<std::shared_ptr<Joystick>> joysticks,
-        std::filesystem::path& img_path
+        const std::vector<std::filesystem::path>& img_paths
         ) {
     joy_manager_ = std::make_unique<JoystickManager>();
     joysticks_ = joysticks;
@@ -92,24 +540,62 @@ std::optional<std::string> App::setup(
         joy_manager_->addJoystick(joy);
     }
 
-    // Setup shaders
-    program_ = std::make_unique<ShaderProgram>();
+    if (captures_.empty()) {
+        addCapture(0);
+    }
+
+    imgs_.clear();
+    for (size_t i = 0; i < img_paths.size(); i++) {
+        ImageInput img;
+        img.image = std::make_unique<Image>();
+        imgs_.push_back(std::move(img));
+    }
+
+    Pipeline pipeline = Pipeline::single(vert_path, frag_path, repeat_);
+    if (!pipeline_path_.empty()) {
+        Error err = pipeline.load(pipeline_path_, vert_path, repeat_);
+        if (err) {
+            return "Error loading pipeline " + pipeline_path_.string() + ": " + err.value();
+        }
+    }
 
-    Error err = program_->loadShader(GL_VERTEX_SHADER, vert_path);
-    if (err.has_value()) {
+    if (joystick_ubo_) {
+        joystick_buffer_ = std::make_unique<JoystickBuffer>();
+        joystick_buffer_->setup(joysticks_, JOYSTICK_BINDING);
+    }
+
+    if (compile_context_) {
+        compiler_ = ShaderCompiler::create(std::move(compile_context_));
+        if (!compiler_) {
+            std::cerr << "Warning: unable to use a shared context, shaders will be rebuilt in line" << std::endl;
+        }
+    }
+
+    Error err = setupPasses(pipeline);
+    if (err) {
         return err;
     }
 
-    err = program_->loadShader(GL_FRAGMENT_SHADER, frag_path);
-    if (err.has_value()) {
+    err = loadImages(img_paths);
+    if (err) {
         return err;
     }
 
-    if (img_path != "") {
-        Error err = img_->setup(img_path, IMG_UNIT);
+    if (seq_dir_ != "") {
+        size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+        seq_ = std::make_unique<ImageSequence>(threads, seq_budget_);
+        Error err = seq_->setup(seq_dir_, seq_fps_);
         if (err) {
             return err;
         }
+
+        std::cerr << "Sequence " << seq_dir_.string() << ": " << seq_->getFrameCount() << " frames, "
+            << seq_->getLayerCount() << " resident at a time" << std::endl;
+    }
+
+    err = assignTextureUnits();
+    if (err) {
+        return err;
     }
 
     // Bind vertex array object
@@ -155,47 +641,236 @@ std::optional<std::string> App::setup(
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Texture creation
-    glGenTextures(1, &webcam_tex_);
-    glBindTexture(GL_TEXTURE_2D, webcam_tex_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    for (auto& cap : captures_) {
+        cap.tex->setup();
+    }
 
     glGenFramebuffers(1, &fbo_);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
 
-    glGenTextures(2, output_texs_);
-    for (const auto& id : output_texs_) {
-        glBindTexture(GL_TEXTURE_2D, id);
+    acquireHistory();
 
-        // Give an empty image to OpenGL ( the last "0" )
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, resolution_.getWidth<GLsizei>(), resolution_.getHeight<GLsizei>(), 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    if (target_ms_ > 0) {
+        governor_ = std::make_unique<ResolutionGovernor>(target_ms_);
     }
 
-    glFramebufferTexture(GL_FRAMEBUFFER, draw_bufs_[SRC], output_texs_[SRC], 0);
-    glFramebufferTexture(GL_FRAMEBUFFER, draw_bufs_[DEST], output_texs_[DEST], 0);
-
     // This comment is a reminder of what we didn't unbind
     // glBindVertexArray(0);
 
     return {};
 }
 
-void App::draw(GLFWwindow* window, double t) {
-    int win_width, win_height;
-    glfwGetWindowSize(window, &win_width, &win_height);
+Error App::setupPasses(const Pipeline& pipeline) {
+    passes_.clear();
+
+    const std::vector<Pipeline::Pass>& descs = pipeline.getPasses();
+    for (const auto& desc : descs) {
+        Pass pass;
+        pass.name = desc.name;
+        pass.repeat = desc.repeat;
+        pass.history = desc.history;
+        pass.keep_prev = desc.keep_prev;
+        pass.last_use = desc.last_use;
+        pass.scale = desc.scale;
+        pass.fixed = desc.size;
+        pass.program = std::make_unique<ShaderProgram>();
+
+        // With one pass there's no need to say which
+        std::string label = descs.size() > 1 ? "Pass '" + desc.name + "': " : "";
+
+        UniformRegistry& uniforms = pass.program->getUniforms();
+        registerUniforms(uniforms);
+
+        for (const auto& input : desc.inputs) {
+            if (input.kind == Pipeline::Input::Kind::Image && input.index >= imgs_.size()) {
+                return label + "reads " + input.sampler + " but there are only "
+                    + std::to_string(imgs_.size()) + " images";
+            }
+
+            if (input.kind == Pipeline::Input::Kind::Capture && input.index >= captures_.size()) {
+                return label + "reads " + input.sampler + " but there are only "
+                    + std::to_string(captures_.size()) + " capture sources";
+            }
+
+            PassInput bound;
+            bound.kind = input.kind;
+            bound.index = input.index;
+            bound.unit = 0;
+            bound.sampler = uniforms.add(input.sampler);
+            bound.resolution = uniforms.add(input.resolution);
+            pass.inputs.push_back(bound);
+        }
+
+        if (joystick_buffer_) {
+            pass.program->addInclude(JoystickBuffer::HEADER_NAME, joystick_buffer_->getHeader());
+            pass.program->bindUniformBlock(JoystickBuffer::BLOCK_NAME, joystick_buffer_->getBinding());
+        }
+
+        Error err = pass.program->loadShader(GL_VERTEX_SHADER, desc.vert);
+        if (err.has_value()) {
+            return label + err.value();
+        }
+
+        err = pass.program->loadShader(GL_FRAGMENT_SHADER, desc.frag);
+        if (err.has_value()) {
+            return label + err.value();
+        }
+
+        // The first build is in line, setup should fail if it doesn't compile
+        pass.program->setCache(program_cache_);
+        err = pass.program->link();
+        if (err.has_value()) {
+            return label + err.value();
+        }
+
+        pass.program->setCompiler(compiler_.get());
+        passes_.push_back(std::move(pass));
+    }
+
+    output_pass_ = pipeline.getOutput();
+    sizePasses();
+
+    if (descs.size() > 1) {
+        std::string order;
+        for (const auto& pass : passes_) {
+            order += (order.empty() ? "" : " -> ") + pass.name;
+        }
+        std::cerr << "Pipeline: " << order << ", output " << passes_[output_pass_].name << std::endl;
+    }
+
+    return {};
+}
+
+void App::sizePasses() {
+    for (auto& pass : passes_) {
+        if (pass.fixed.getWidth<int>() != 0) {
+            pass.size = pass.fixed;
+            continue;
+        }
+
+        // Never rounded away to nothing
+        int width = static_cast<int>(std::lround(resolution_.getWidth<double>() * render_scale_ * pass.scale));
+        int height = static_cast<int>(std::lround(resolution_.getHeight<double>() * render_scale_ * pass.scale));
+        pass.size.set(std::max(width, 1), std::max(height, 1));
+    }
+}
+
+void App::resizeTargets() {
+    std::vector<Size> old_sizes;
+    for (const auto& pass : passes_) {
+        old_sizes.push_back(pass.size);
+    }
+    sizePasses();
+
+    GLuint read_fbo;
+    glGenFramebuffers(1, &read_fbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glDrawBuffer(OUTPUT_ATTACHMENT);
+
+    // Only passes with history have targets between frames. Their contents are
+    // scaled across, so feedback carries on instead of starting over.
+    for (size_t i = 0; i < passes_.size(); i++) {
+        Pass& pass = passes_[i];
+        Size& old_size = old_sizes[i];
+        bool same = old_size.getWidth<int>() == pass.size.getWidth<int>() && old_size.getHeight<int>() == pass.size.getHeight<int>();
+        if (!pass.history || same) {
+            continue;
+        }
+
+        for (auto& target : pass.targets) {
+            if (target == GL_FALSE) {
+                continue;
+            }
+
+            GLuint resized = targets_.acquire(pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+            glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, 0);
+            glFramebufferTexture(GL_DRAW_FRAMEBUFFER, OUTPUT_ATTACHMENT, resized, 0);
+            glBlitFramebuffer(
+                0,0, old_size.getWidth<GLint>(), old_size.getHeight<GLint>(),
+                0,0, pass.size.getWidth<GLint>(), pass.size.getHeight<GLint>(),
+                GL_COLOR_BUFFER_BIT,
+                GL_LINEAR
+            );
+
+            targets_.release(target);
+            target = resized;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glDeleteFramebuffers(1, &read_fbo);
+    targets_.trim();
+
+    Size& out_size = passes_[output_pass_].size;
+    std::cerr << "Rendering at " << out_size.getWidth<int>() << "x" << out_size.getHeight<int>()
+        << " to hold " << governor_->getTargetMs() << " ms/frame" << std::endl;
+}
+
+// Passes with history keep their targets for good, the rest borrow one as they
+// draw. A pass that samples lastOut draws over its own last output, so it has
+// history whatever the pipeline said. That's checked every frame between
+// passes drawing, since an edit can start using lastOut at any time.
+void App::acquireHistory() {
+    for (auto& pass : passes_) {
+        if (!pass.history && pass.program->getUniforms().isActive(uniforms_.last_out)) {
+            pass.history = true;
+        }
+
+        // Only history passes hold [1], so a pass that has one is already set up
+        if (!pass.history || pass.targets[1] != GL_FALSE) {
+            continue;
+        }
+
+        pass.targets[0] = targets_.acquire(pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+        pass.targets[1] = targets_.acquire(pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+        if (pass.keep_prev) {
+            pass.targets[2] = targets_.acquire(pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+        }
+    }
+}
 
+bool App::isActive(Slot slot) const {
+    return std::any_of(passes_.begin(), passes_.end(), [slot](const Pass& pass) {
+        return pass.program->getUniforms().isActive(slot);
+    });
+}
+
+void App::render(double t) {
+    profiler_.collect();
+    readback_.poll();
+    capture_readback_.poll();
+    profiler_.start(phases_.render);
+    if (governor_) {
+        governor_->beginFrame();
+    }
+
+    profiler_.start(phases_.joystick_update);
     joy_manager_->update();
     for (auto& joy : joysticks_) {
         joy->update(t);
     }
 
-    std::string err = program_->update().value_or("");
+    if (joystick_buffer_) {
+        joystick_buffer_->upload();
+    }
+    profiler_.stop(phases_.joystick_update);
+
+    // With one pass there's no need to say which
+    auto label = [this](const Pass& pass) {
+        return passes_.size() > 1 ? "Pass '" + pass.name + "': " : std::string();
+    };
+
+    profiler_.start(phases_.shader_update);
+    std::string err;
+    for (const auto& pass : passes_) {
+        Error pass_err = pass.program->update();
+        if (pass_err) {
+            err += (err.empty() ? "" : "\n") + label(pass) + pass_err.value();
+        }
+    }
+    profiler_.stop(phases_.shader_update);
     if (err != "") {
         if (err != last_err_) {
             std::cerr << err << std::endl;
@@ -206,122 +881,273 @@ void App::draw(GLFWwindow* window, double t) {
         last_err_ = "";
     }
 
-    for (int i = 0; i < repeat_; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
-        glDrawBuffer(draw_bufs_[DEST]);
-  
-        // Use our shader
-        GLuint program = program_->getProgram();
-        glUseProgram(program);
-
-        if (img_->isInitialized()) {
-            program_->setUniform("img0", [this](GLint& id) {
-                glActiveTexture(img_->getTextureUnit());
-                glBindTexture(GL_TEXTURE_2D, img_->getID());
-                glUniform1i(id, img_->getTextureUnit());
-            });
-        }
-        program_->setUniform("iteration", [program, i](GLint& id) {
-            glProgramUniform1i(program, id, i);
-        });
-
-        if (img_->isInitialized()) {
-            program_->setUniform("img0", [this](GLint& id) {
-                glActiveTexture(IMG_UNIT_GL);
-                glBindTexture(GL_TEXTURE_2D, img_->getID());
-                glUniform1i(id, 0);
-            });
-
-            program_->setUniform("iResolutionImg0", [this, program](GLint& id) {
-                Size img_size = img_->getSize(); 
-                glProgramUniform2f(program, id, img_size.getWidth<float>(), img_size.getHeight<float>());
-            });
-        }
-
-        // Read webcam
-        std::optional<GLint> webcam_loc = program_->getUniformLoc("cap0");
-        if ((program_->getUniformLoc("iResolutionCap0") || webcam_loc) && setupWebcam(0)) {
-            cv::Mat frame;
-            if (webcam_->read(frame) && webcam_loc) {
-                cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
-                flip(frame, frame, -1);
-
-                cv::Size size = frame.size();
-
-                glActiveTexture(WEBCAM_UNIT_GL);
-                glBindTexture(GL_TEXTURE_2D, webcam_tex_);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size.width, size.height, 0, GL_RGB, GL_UNSIGNED_BYTE, frame.data);
-                glUniform1i(webcam_loc.value(), WEBCAM_UNIT);
-            }
+    // Everything that holds for the whole frame is established once, up front
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glDrawBuffer(OUTPUT_ATTACHMENT);
+
+    profiler_.start(phases_.webcam_upload);
+    updateCaptures(t);
+    profiler_.stop(phases_.webcam_upload);
+
+    profiler_.start(phases_.sequence_upload);
+    if (seq_ && isActive(uniforms_.seq0)) {
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + seq_unit_));
+        seq_->update(t);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, seq_->getID());
+    }
+    profiler_.stop(phases_.sequence_upload);
 
-            program_->markUniformInUse("cap0");
-            program_->setUniform("iResolutionCap0", [this, program](GLint& id) {
-                glProgramUniform2f(program, id, (GLfloat) webcam_->getWidth(), (GLfloat) webcam_->getHeight());
-            });
+    profiler_.start(phases_.image_reload);
+    if (!imgs_.empty()) {
+        reloadImages();
+    }
+    profiler_.stop(phases_.image_reload);
+
+    // Inputs keep their units for the whole frame, and uniforms are program
+    // state, so every pass is set up before any of them draws
+    profiler_.start(phases_.uniforms);
+    for (const auto& img : imgs_) {
+        if (isActive(img.sampler)) {
+            glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + img.unit));
+            glBindTexture(GL_TEXTURE_2D, img.image->getID());
         }
+    }
 
-        program_->setUniform("iResolution", [this, program](GLint& id) {
-            glProgramUniform2f(program, id, resolution_.getWidth<float>(), resolution_.getHeight<float>());
-        });
+    for (auto& pass : passes_) {
+        glUseProgram(pass.program->getProgram());
+        setUniforms(pass.program->getUniforms(), t);
+    }
+    profiler_.stop(phases_.uniforms);
 
-        program_->setUniform("iTime", [t, program](GLint& id) {
-            glProgramUniform1f(program, id, (float)t);
-        });
+    // Last frame's output has been shown and read back by now
+    if (held_output_ != GL_FALSE) {
+        targets_.release(held_output_);
+        held_output_ = GL_FALSE;
+    }
 
-        program_->setUniform("lastOut", [this](GLint& id) {
-            glActiveTexture(LAST_OUTPUT_UNIT_GL);
-            glBindTexture(GL_TEXTURE_2D, output_texs_[SRC]);
-            glUniform1i(id, LAST_OUTPUT_UNIT);
-        });
-
-        program_->setUniform("firstPass", [this, program](GLint& id) {
-            glProgramUniform1i(program, id, first_pass_);
-        });
-
-        int joy_idx = 1;
-        for (const auto& joy : joysticks_) {
-            auto outs = joy->getOutputs();
-            for (const auto& kv : outs) {
-                const std::string& name = kv.first;
-                const JoystickOutput& ctrl = kv.second;
-                const std::string base = "j" + std::to_string(joy_idx) + name;
-
-                program_->setUniform(base + "Pressed", [ctrl, program](GLint& id) {
-                    glProgramUniform1i(program, id, ctrl.pressed ? 1 : 0);
-                });
-
-                program_->setUniform(base + "PressedNew", [ctrl, program](GLint& id) {
-                    glProgramUniform1i(program, id, ctrl.pressed_new ? 1 : 0);
-                });
-
-                program_->setUniform(base + "Time", [ctrl, program](GLint& id) {
-                    glProgramUniform1f(program, id, (float)ctrl.time);
-                });
-
-                program_->setUniform(base + "TimeTotal", [ctrl, program](GLint& id) {
-                    glProgramUniform1f(program, id, (float)ctrl.time_total);
-                });
-
-                program_->setUniform(base, [ctrl, program](GLint& id) {
-                    glProgramUniform1f(program, id, ctrl.value);
-                });
+    // Between frames every pooled target is free, so the old sizes can go right away
+    if (governor_ && governor_->update()) {
+        render_scale_ = governor_->getScale();
+        resizeTargets();
+    }
+
+    acquireHistory();
+
+    for (auto& pass : passes_) {
+        pass.drawn = false;
+    }
+
+    for (size_t i = 0; i < passes_.size(); i++) {
+        drawPass(i);
+    }
+
+    Pass& output = passes_[output_pass_];
+    glFramebufferTexture(GL_FRAMEBUFFER, OUTPUT_ATTACHMENT, output.targets[0], 0);
+    if (!output.history) {
+        held_output_ = output.targets[0];
+        output.targets[0] = GL_FALSE;
+    }
+
+    if (governor_) {
+        governor_->endFrame();
+    }
+
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (recorder_ || sequence_writer_) {
+        captureFrame();
+    }
+
+    std::string warning;
+    for (const auto& pass : passes_) {
+        for (const auto& unset : pass.program->getUnsetUniforms()) {
+            warning += "WARNING: " + label(pass) + "unset in-use uniform '" + unset + "'\n";
+        }
+    }
+    if (warning != "") {
+        if (warning != last_warning_) {
+            // There's a newline at the end of warning
+            std::cerr << warning << std::flush;
+            last_warning_ = warning;
+        }
+    } else if (last_warning_ != "") {
+        std::cerr << "- No More Warnings! - " << std::endl;
+        last_warning_ = "";
+    }
+
+    first_pass_ = false;
+
+    profiler_.stop(phases_.render);
+}
+
+void App::setUniforms(UniformRegistry& uniforms, double t) {
+    for (const auto& img : imgs_) {
+        if (uniforms.isActive(img.sampler)) {
+            uniforms.set(img.sampler, img.unit);
+        }
+
+        Size img_size = img.image->getSize();
+        uniforms.set(img.resolution, img_size.getWidth<float>(), img_size.getHeight<float>());
+    }
+
+    for (const auto& cap : captures_) {
+        if (!cap.open) {
+            continue;
+        }
+
+        if (uniforms.isActive(cap.sampler)) {
+            uniforms.set(cap.sampler, cap.unit);
+        }
+
+        if (cap.video) {
+            uniforms.set(cap.resolution, (GLfloat) cap.video->getWidth(), (GLfloat) cap.video->getHeight());
+        } else {
+            uniforms.set(cap.resolution, (GLfloat) cap.webcam->getWidth(), (GLfloat) cap.webcam->getHeight());
+        }
+    }
+
+    if (seq_) {
+        if (uniforms.isActive(uniforms_.seq0)) {
+            uniforms.set(uniforms_.seq0, seq_unit_);
+        }
+
+        Size seq_size = seq_->getSize();
+        uniforms.set(uniforms_.seq0_layer, seq_->getLayer());
+        uniforms.set(uniforms_.seq0_frame, seq_->getFrame());
+        uniforms.set(uniforms_.seq0_frames, static_cast<GLint>(seq_->getFrameCount()));
+        uniforms.set(uniforms_.res_seq0, seq_size.getWidth<float>(), seq_size.getHeight<float>());
+    }
+
+    uniforms.set(uniforms_.time, (float)t);
+    uniforms.set(uniforms_.first_pass, first_pass_ ? 1 : 0);
+    uniforms.set(uniforms_.last_out, LAST_OUTPUT_UNIT);
+
+    for (size_t joy_idx = 0; joy_idx < joystick_uniforms_.size(); joy_idx++) {
+        const std::vector<JoystickUniforms>& slots = joystick_uniforms_[joy_idx];
+
+        size_t out_idx = 0;
+        for (const auto& kv : joysticks_[joy_idx]->getOutputs()) {
+            const JoystickOutput& ctrl = kv.second;
+            const JoystickUniforms& joy_slots = slots[out_idx++];
+
+            uniforms.set(joy_slots.pressed, ctrl.pressed ? 1 : 0);
+            uniforms.set(joy_slots.pressed_new, ctrl.pressed_new ? 1 : 0);
+            uniforms.set(joy_slots.time, (float)ctrl.time);
+            uniforms.set(joy_slots.time_total, (float)ctrl.time_total);
+            uniforms.set(joy_slots.value, ctrl.value);
+        }
+    }
+}
+
+void App::drawPass(size_t idx) {
+    Pass& pass = passes_[idx];
+    glUseProgram(pass.program->getProgram());
+    UniformRegistry& uniforms = pass.program->getUniforms();
+
+    // iResolution is the size of what this pass draws, which needn't be the output's
+    glViewport(0,0, pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+    uniforms.set(uniforms_.resolution, pass.size.getWidth<float>(), pass.size.getHeight<float>());
+
+    // Images and captures are bound for the whole frame, other passes' output is bound here
+    std::vector<const PassInput*> own_prev;
+    for (const auto& input : pass.inputs) {
+        GLuint tex = GL_FALSE;
+        if (input.kind == Pipeline::Input::Kind::Pass) {
+            tex = passes_[input.index].targets[0];
+        } else if (input.kind == Pipeline::Input::Kind::PassPrev) {
+            // Until a pass draws this frame, its newest output is last frame's
+            const Pass& source = passes_[input.index];
+            if (!source.drawn) {
+                tex = source.targets[0];
+            } else {
+                tex = source.keep_prev ? source.targets[2] : source.targets[1];
             }
+        } else {
+            continue;
+        }
+
+        Size source_size = passes_[input.index].size;
+        uniforms.set(input.resolution, source_size.getWidth<float>(), source_size.getHeight<float>());
+        if (!uniforms.isActive(input.sampler)) {
+            continue;
+        }
 
-            joy_idx++;
+        uniforms.set(input.sampler, input.unit);
+        if (input.kind == Pipeline::Input::Kind::PassPrev && input.index == idx) {
+            own_prev.push_back(&input);
+            continue;
         }
 
-        glViewport(0,0, resolution_.getWidth<GLsizei>(), resolution_.getHeight<GLsizei>());
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + input.unit));
+        glBindTexture(GL_TEXTURE_2D, tex);
+    }
+
+    if (!pass.history) {
+        pass.targets[0] = targets_.acquire(pass.size.getWidth<GLsizei>(), pass.size.getHeight<GLsizei>());
+    }
+
+    // Set aside where the iterations won't draw over it
+    GLuint prev_frame = pass.targets[0];
+    if (pass.keep_prev) {
+        std::swap(pass.targets[0], pass.targets[2]);
+    }
+
+    // Only the iteration number, the feedback texture and the draw target change per iteration
+    bool bind_last_out = uniforms.isActive(uniforms_.last_out);
+    for (int i = 0; i < pass.repeat; i++) {
+        profiler_.start(phases_.iteration);
+
+        // What it drew last becomes what it reads, and the other target is drawn over
+        if (pass.history) {
+            std::swap(pass.targets[0], pass.targets[1]);
+        }
+        glFramebufferTexture(GL_FRAMEBUFFER, OUTPUT_ATTACHMENT, pass.targets[0], 0);
+
+        uniforms.set(uniforms_.iteration, i);
+        if (bind_last_out) {
+            // The first iteration follows on from last frame's last
+            GLuint last_out = i == 0 ? prev_frame : pass.targets[1];
+            glActiveTexture(LAST_OUTPUT_UNIT_GL);
+            glBindTexture(GL_TEXTURE_2D, pass.history ? last_out : GL_FALSE);
+        }
+
+        // Its own .prev is last frame's output on every iteration, never the draw target
+        for (const PassInput* input : own_prev) {
+            glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + input->unit));
+            glBindTexture(GL_TEXTURE_2D, prev_frame);
+        }
 
         // Draw our vertices
+        profiler_.startGPU(phases_.iteration);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glUseProgram(0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        profiler_.stopGPU();
 
-        // Swap the ping pong buffer!
-        std::swap(draw_bufs_[SRC], draw_bufs_[DEST]);
-        std::swap(output_texs_[SRC], output_texs_[DEST]);
+        profiler_.stop(phases_.iteration);
     }
 
+    pass.drawn = true;
+
+    // Hand back what nothing later in the frame reads, the output is kept until the next frame
+    for (size_t i = 0; i <= idx; i++) {
+        Pass& other = passes_[i];
+        if (!other.history && i != output_pass_ && other.last_use == idx && other.targets[0] != GL_FALSE) {
+            targets_.release(other.targets[0]);
+            other.targets[0] = GL_FALSE;
+        }
+    }
+}
+
+void App::draw(GLFWwindow* window, double t) {
+    render(t);
+
+    int win_width, win_height;
+    glfwGetWindowSize(window, &win_width, &win_height);
+
+    // Smaller than resolution_ while the governor has it scaled down
+    Size out_size = passes_[output_pass_].size;
+    bool scaled = out_size.getWidth<int>() != resolution_.getWidth<int>() || out_size.getHeight<int>() != resolution_.getHeight<int>();
+
     // Calculate blit settings
     DrawInfo draw_info = DrawInfo::scaleCenter(
             resolution_.getWidth<float>(),
@@ -330,33 +1156,18 @@ void App::draw(GLFWwindow* window, double t) {
             static_cast<float>(win_height));
 
     // Draw to the screen
+    profiler_.start(phases_.blit);
     glDrawBuffer(GL_BACK);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
-    glReadBuffer(draw_bufs_[SRC]);
+    glReadBuffer(OUTPUT_ATTACHMENT);
     glViewport(0,0, win_width, win_height);
     glBlitFramebuffer(
-        0,0, resolution_.getWidth<GLsizei>(), resolution_.getHeight<GLsizei>(),
+        0,0, out_size.getWidth<GLsizei>(), out_size.getHeight<GLsizei>(),
         draw_info.x0, draw_info.y0, draw_info.x1, draw_info.y1,
-        GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
-        GL_NEAREST
+        GL_COLOR_BUFFER_BIT,
+        scaled ? GL_LINEAR : GL_NEAREST
     );
-
-    std::string warning;
-    for (const auto& unset : program_->getUnsetUniforms()) {
-        warning += "WARNING: unset in-use uniform '" + unset + "'\n";
-    }
-    if (warning != "") {
-        if (warning != last_warning_) {
-            // There's a newline at the end of warning
-            std::cerr << warning << std::flush;
-            last_warning_ = warning;
-        }
-    } else if (last_warning_ != "") {
-        std::cerr << "- No More Warnings! - " << std::endl;
-        last_warning_ = "";
-    }
-
-    first_pass_ = false;
+    profiler_.stop(phases_.blit);
 }
 
 void App::onKey(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
@@ -381,8 +1192,9 @@ void App::onError(int /* error */, const char* desc) {
     fputs(desc, stderr);
 }
 
-#undef WEBCAM_UNIT
-#undef IMG_UNIT
 #undef LAST_OUTPUT_UNIT
-#undef SRC
-#undef DEST
+#undef LAST_OUTPUT_UNIT_GL
+#undef FIRST_INPUT_UNIT
+#undef MAX_CAPTURES
+#undef JOYSTICK_BINDING
+#undef OUTPUT_ATTACHMENT
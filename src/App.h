@@ -2,6 +2,7 @@
 #define APP_H
 
 #include <filesystem>
+#include <future>
 #include <optional>
 
 #include <GL/glew.h>
@@ -15,40 +16,228 @@
 #include "Webcam.h"
 #include "Image.h"
 #include "Size.h"
+#include "Profiler.h"
+#include "JoystickBuffer.h"
+#include "Readback.h"
+#include "ImageWriter.h"
+#include "PipeRecorder.h"
+#include "StreamTexture.h"
+#include "VideoSource.h"
+#include "ImageSequence.h"
+#include "FileWatcher.h"
+#include "ThreadPool.h"
+#include "SharedContext.h"
+#include "ShaderCompiler.h"
+#include "Pipeline.h"
+#include "RenderTargetPool.h"
+#include "ResolutionGovernor.h"
 
 class App {
     public:
         App(const std::filesystem::path& out_dir, Size resolution, int repeat);
-        Error setup(std::filesystem::path vert_path, std::filesystem::path frag_path, std::vector<std::shared_ptr<Joystick>> joysticks, std::filesystem::path& path);
+        Error setup(std::filesystem::path vert_path, std::filesystem::path frag_path, std::vector<std::shared_ptr<Joystick>> joysticks, const std::vector<std::filesystem::path>& img_paths);
+        void render(double t);
         void draw(GLFWwindow* window, double t);
         void onError(int error, const char* desc);
         void onWindowSize(GLFWwindow* window, int width, int height);
         void onKey(GLFWwindow* window, int key, int scancode, int action, int mods);
         Error screenshot();
-        bool setupWebcam(int dev);
+        Error writeOutput(const std::filesystem::path& dest);
+        void finishOutput();
+        Error startRecording(const std::string& path, PipeRecorder::Format format, unsigned int fps, bool lossless);
+        void startSequence(const std::string& prefix, size_t encoders);
+        static std::string timestampName();
+        // Maps the next capN to a device, cap0 is device 0 if none are added before setup
+        Error addCapture(int device);
+        // Maps the next capN to a video file, played back in step with iTime
+        Error addVideo(const std::filesystem::path& path);
+        // Bytes of new capture frames uploaded per frame before the rest wait a frame
+        void setCaptureBudget(size_t bytes);
+        Profiler& getProfiler();
+        void setJoystickUBO(bool enabled);
+        void setWebcamSettings(const WebcamSettings& settings);
+        void setVideoSettings(const VideoSettings& settings);
+        // Where decoded images and linked shader programs are cached between runs, empty for no cache
+        void setCacheDir(const std::filesystem::path& dir);
+        // Directory of PNGs to play as seq0, streamed through at most budget_bytes of texture
+        void setSequence(const std::filesystem::path& dir, double fps, size_t budget_bytes);
+        // Context to rebuild edited shaders on in the background, so the show never waits on the compiler
+        void setCompileContext(std::unique_ptr<SharedContext> context);
+        // A YAML render graph to draw instead of the one fragment shader given to setup
+        void setPipeline(const std::filesystem::path& path);
+        // Lowers the render resolution below -r while the GPU takes longer than this per frame
+        void setTargetFrameTime(double ms);
 
     private:
+        using Slot = UniformRegistry::Slot;
+
+        struct JoystickUniforms {
+            Slot value;
+            Slot pressed;
+            Slot pressed_new;
+            Slot time;
+            Slot time_total;
+        };
+
+        struct ImageInput {
+            std::filesystem::path path;
+            std::unique_ptr<Image> image;
+            // Valid while a changed file is decoding
+            std::future<Error> reload;
+            GLint unit;
+            Slot sampler;
+            Slot resolution;
+        };
+
+        // Either a device or a video file
+        struct Capture {
+            int device = -1;
+            std::filesystem::path video_path;
+            std::unique_ptr<Webcam> webcam;
+            std::unique_ptr<VideoSource> video;
+            std::unique_ptr<StreamTexture> tex;
+            // Whether it opened this frame
+            bool open = false;
+            std::string last_err;
+            GLint unit;
+            Slot sampler;
+            Slot resolution;
+        };
+
+        // One of a pass's inputs, as bound for its shader
+        struct PassInput {
+            Pipeline::Input::Kind kind;
+            size_t index;
+            GLint unit;
+            Slot sampler;
+            Slot resolution;
+        };
+
+        struct Pass {
+            std::string name;
+            std::unique_ptr<ShaderProgram> program;
+            int repeat;
+            bool history;
+            size_t last_use;
+            double scale;
+            // Fixed, or 0x0 to follow resolution_ by scale
+            Size fixed;
+            // What it's drawn at
+            Size size;
+            std::vector<PassInput> inputs;
+            bool keep_prev;
+            // With history, [0] is its newest output and [1] the one before. With
+            // keep_prev, [2] holds last frame's output while this frame's iterations
+            // go back and forth between the other two. Otherwise [0] is a pooled
+            // target, held from when it draws until its last reader has.
+            GLuint targets[3] = {};
+            bool drawn = false;
+        };
+
+        Error setupPasses(const Pipeline& pipeline);
+        void registerUniforms(UniformRegistry& uniforms);
+        void sizePasses();
+        void resizeTargets();
+        void acquireHistory();
+        bool isActive(Slot slot) const;
+        void setUniforms(UniformRegistry& uniforms, double t);
+        void drawPass(size_t idx);
+        void captureFrame();
+        Error loadImages(const std::vector<std::filesystem::path>& paths);
+        void reloadImages();
+        Error assignTextureUnits();
+        Error addSource(Capture cap);
+        bool setupCapture(Capture& cap);
+        void updateCaptures(double t);
+
         GLuint ebo = GL_FALSE;
         GLuint vao = GL_FALSE;
         GLuint pos_vbo_ = GL_FALSE;
         GLuint coord_vbo_ = GL_FALSE;
-        GLuint webcam_tex_ = GL_FALSE;
         GLuint fbo_ = GL_FALSE;
 
-        GLuint output_texs_[2] = {};
-        GLuint draw_bufs_[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        RenderTargetPool targets_;
+        // The output's target when it came from the pool, kept until the next frame for the blit and readbacks
+        GLuint held_output_ = GL_FALSE;
+        double target_ms_ = 0;
+        std::unique_ptr<ResolutionGovernor> governor_;
+        // Of resolution_, what passes that follow it are drawn at
+        double render_scale_ = 1.0;
 
-        std::unique_ptr<Image> img_;
-        std::unique_ptr<ShaderProgram> program_;
+        std::vector<ImageInput> imgs_;
+        std::unique_ptr<ImageCache> image_cache_;
+        FileWatcher image_watcher_;
+        std::unique_ptr<SharedContext> compile_context_;
+        // Before passes_, which hand work to it until they're gone
+        std::unique_ptr<ShaderCompiler> compiler_;
+        std::shared_ptr<ProgramCache> program_cache_;
+        std::filesystem::path pipeline_path_;
+        // In drawing order
+        std::vector<Pass> passes_;
+        size_t output_pass_ = 0;
+        GLint first_pass_unit_ = 0;
         std::unique_ptr<JoystickManager> joy_manager_;
         std::vector<std::shared_ptr<Joystick>> joysticks_;
         std::string last_err_ = "";
         std::string last_warning_ = "";
         const std::filesystem::path out_dir_;
-        std::unique_ptr<Webcam> webcam_;
+        std::vector<Capture> captures_;
+        WebcamSettings webcam_settings_;
+        VideoSettings video_settings_;
+        size_t capture_budget_ = 0;
+        size_t next_capture_ = 0;
+        std::unique_ptr<ImageSequence> seq_;
+        std::filesystem::path seq_dir_;
+        double seq_fps_ = 0;
+        size_t seq_budget_ = 0;
+        GLint seq_unit_ = 0;
         Size resolution_;
+        Profiler profiler_;
+        Readback readback_;
+        ImageWriter image_writer_;
+        Readback capture_readback_;
+        std::unique_ptr<PipeRecorder> recorder_;
+        bool record_lossless_ = false;
+        std::unique_ptr<ImageWriter> sequence_writer_;
+        std::string sequence_prefix_;
+        size_t sequence_frame_ = 0;
+
+        struct {
+            Slot seq0;
+            Slot seq0_layer;
+            Slot seq0_frame;
+            Slot seq0_frames;
+            Slot res_seq0;
+            Slot resolution;
+            Slot time;
+            Slot iteration;
+            Slot last_out;
+            Slot first_pass;
+        } uniforms_;
+
+        // Parallel to joysticks_ and each joystick's (ordered) outputs
+        std::vector<std::vector<JoystickUniforms>> joystick_uniforms_;
+        std::unique_ptr<JoystickBuffer> joystick_buffer_;
+        bool joystick_ubo_ = false;
+
+        struct {
+            Profiler::Phase render;
+            Profiler::Phase joystick_update;
+            Profiler::Phase shader_update;
+            Profiler::Phase webcam_read;
+            Profiler::Phase webcam_upload;
+            Profiler::Phase sequence_upload;
+            Profiler::Phase image_reload;
+            Profiler::Phase uniforms;
+            Profiler::Phase iteration;
+            Profiler::Phase blit;
+        } phases_;
+
         bool first_pass_ = true;
         int repeat_;
+
+        // Last, so reloads still decoding finish before the images they decode into go away
+        std::unique_ptr<ThreadPool> reload_pool_;
 };
 
 #endif
@@ -0,0 +1,48 @@
+#include "AtomicWrite.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+Error writeAtomically(const std::filesystem::path& dest, const std::function<void(std::ostream&)>& fill) {
+    std::error_code ec;
+    std::filesystem::create_directories(dest.parent_path(), ec);
+    if (ec) {
+        return "Unable to create " + dest.parent_path().string() + ": " + ec.message();
+    }
+
+    std::string pattern = dest.string() + ".XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if (fd < 0) {
+        return "Unable to create a temporary file for " + dest.string() + ": " + std::strerror(errno);
+    }
+    close(fd);
+    std::filesystem::path tmp(name.data());
+
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        fill(out);
+
+        if (!out) {
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return "Unable to write " + tmp.string();
+        }
+    }
+
+    std::filesystem::rename(tmp, dest, ec);
+    if (ec) {
+        Error err = "Unable to write " + dest.string() + ": " + ec.message();
+        std::filesystem::remove(tmp, ec);
+        return err;
+    }
+
+    return {};
+}
@@ -0,0 +1,16 @@
+#ifndef ATOMIC_WRITE_H
+#define ATOMIC_WRITE_H
+
+#include <filesystem>
+#include <functional>
+#include <ostream>
+
+#include "Result.h"
+
+// Writes dest so readers only ever see it whole. fill writes the contents into
+// a temporary file beside dest, named by mkstemp so threads and separate
+// processes sharing a directory never write the same one, and it's renamed
+// over dest once complete. dest's directory is created if need be.
+Error writeAtomically(const std::filesystem::path& dest, const std::function<void(std::ostream&)>& fill);
+
+#endif
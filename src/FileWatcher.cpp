@@ -0,0 +1,279 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+// Finished writes, renames into the directory (atomic saves) and new files
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE)
+#endif
+
+FileWatcher::FileWatcher(std::chrono::milliseconds debounce, std::chrono::milliseconds poll_interval)
+    : debounce_(debounce), poll_interval_(poll_interval), has_changes_(false) {
+#ifdef __linux__
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd_ < 0 || wake_fd_ < 0) {
+        // Everything gets polled instead
+        if (inotify_fd_ >= 0) {
+            close(inotify_fd_);
+        }
+        if (wake_fd_ >= 0) {
+            close(wake_fd_);
+        }
+        inotify_fd_ = -1;
+        wake_fd_ = -1;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+    {
+        std::lock_guard guard(mutex_);
+        running_ = false;
+    }
+    wake();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+#ifdef __linux__
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+        close(wake_fd_);
+    }
+#endif
+}
+
+void FileWatcher::watch(const std::filesystem::path& path) {
+    std::filesystem::path file_path = std::filesystem::absolute(path).lexically_normal();
+    std::filesystem::path dir = file_path.parent_path();
+
+    std::lock_guard guard(mutex_);
+    if (files_.count(file_path)) {
+        return;
+    }
+
+    File file;
+    file.polled = true;
+#ifdef __linux__
+    if (inotify_fd_ >= 0) {
+        // Watching the same directory again hands back the same descriptor
+        int wd = inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_EVENTS);
+        if (wd >= 0) {
+            dirs_[wd] = dir;
+            file.polled = false;
+        }
+    }
+#endif
+
+    if (file.polled) {
+        std::error_code ec;
+        file.seen = file.reported = std::filesystem::last_write_time(file_path, ec);
+    }
+    files_[file_path] = file;
+
+    // Nothing to do until there's something to watch
+    if (!running_) {
+        running_ = true;
+        thread_ = std::thread([this]{ run(); });
+    } else {
+        wake();
+    }
+}
+
+std::vector<std::filesystem::path> FileWatcher::poll() {
+    if (!has_changes_.load()) {
+        return {};
+    }
+
+    std::lock_guard guard(mutex_);
+    std::vector<std::filesystem::path> changed(changed_.begin(), changed_.end());
+    changed_.clear();
+    has_changes_ = false;
+
+    return changed;
+}
+
+void FileWatcher::wake() {
+#ifdef __linux__
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+    }
+#endif
+    cond_.notify_all();
+}
+
+void FileWatcher::run() {
+    std::unique_lock lock(mutex_);
+    Clock::time_point next_stat = Clock::now();
+    while (running_) {
+        Clock::time_point now = Clock::now();
+        bool any_polled = std::any_of(files_.begin(), files_.end(), [](const auto& kv) { return kv.second.polled; });
+        if (any_polled && now >= next_stat) {
+            statPolled(lock);
+            next_stat = now + poll_interval_;
+        }
+
+        settle(now);
+
+        // Sleep until a pending change settles or it's time to stat again
+        Clock::time_point until = Clock::time_point::max();
+        if (any_polled) {
+            until = next_stat;
+        }
+        for (const auto& kv : pending_) {
+            until = std::min(until, kv.second + debounce_);
+        }
+
+        if (running_) {
+            wait(lock, until);
+        }
+    }
+}
+
+void FileWatcher::wait(std::unique_lock<std::mutex>& lock, Clock::time_point until) {
+#ifdef __linux__
+    if (inotify_fd_ >= 0) {
+        int timeout = -1;
+        if (until != Clock::time_point::max()) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(until - Clock::now());
+            timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(remaining.count(), 0));
+        }
+
+        struct pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        lock.unlock();
+        ::poll(fds, 2, timeout);
+        lock.lock();
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count = 0;
+            ssize_t got = read(wake_fd_, &count, sizeof(count));
+            (void)got;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+        }
+
+        return;
+    }
+#endif
+
+    if (until == Clock::time_point::max()) {
+        cond_.wait(lock);
+    } else {
+        cond_.wait_until(lock, until);
+    }
+}
+
+void FileWatcher::readEvents() {
+#ifdef __linux__
+    alignas(struct inotify_event) char buf[4096];
+    Clock::time_point now = Clock::now();
+
+    while (true) {
+        ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char* ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            // Events were lost, so anything could have changed
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (const auto& kv : files_) {
+                    pending_[kv.first] = now;
+                }
+                continue;
+            }
+
+            auto dir = dirs_.find(event->wd);
+            if (dir == dirs_.end()) {
+                continue;
+            }
+
+            // The directory itself went away, fall back to polling what was in it
+            if (event->mask & IN_IGNORED) {
+                for (auto& kv : files_) {
+                    if (kv.first.parent_path() == dir->second) {
+                        std::error_code ec;
+                        kv.second.polled = true;
+                        kv.second.seen = kv.second.reported = std::filesystem::last_write_time(kv.first, ec);
+                    }
+                }
+                dirs_.erase(dir);
+                continue;
+            }
+
+            if (event->len > 0) {
+                std::filesystem::path path = dir->second / event->name;
+                if (files_.count(path)) {
+                    pending_[path] = now;
+                }
+            }
+        }
+    }
+#endif
+}
+
+void FileWatcher::statPolled(std::unique_lock<std::mutex>& lock) {
+    std::vector<std::filesystem::path> paths;
+    for (const auto& kv : files_) {
+        if (kv.second.polled) {
+            paths.push_back(kv.first);
+        }
+    }
+
+    // Stat without the lock, so poll() never waits on a slow disk
+    std::vector<std::pair<std::filesystem::path, Time>> mtimes;
+    lock.unlock();
+    for (const auto& path : paths) {
+        std::error_code ec;
+        Time mtime = std::filesystem::last_write_time(path, ec);
+        // Missing for a moment while an editor swaps in the new version
+        if (!ec) {
+            mtimes.emplace_back(path, mtime);
+        }
+    }
+    lock.lock();
+
+    // Polling debounces by waiting for the mtime to hold still for an interval
+    for (const auto& [path, mtime] : mtimes) {
+        File& file = files_[path];
+        if (mtime != file.seen) {
+            file.seen = mtime;
+        } else if (file.seen != file.reported) {
+            file.reported = file.seen;
+            changed_.insert(path);
+            has_changes_ = true;
+        }
+    }
+}
+
+void FileWatcher::settle(Clock::time_point now) {
+    for (auto it = pending_.begin(); it != pending_.end(); ) {
+        if (now - it->second >= debounce_) {
+            changed_.insert(it->first);
+            has_changes_ = true;
+            it = pending_.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+#ifdef __linux__
+#undef WATCH_EVENTS
+#endif
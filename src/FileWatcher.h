@@ -0,0 +1,71 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Watches files for changes on a background thread, so whoever asks never
+// waits on the filesystem. On Linux this is inotify on each file's directory,
+// which also catches saves that write a new file and rename it over the old
+// one. Elsewhere, or if inotify isn't available, mtimes are polled.
+//
+// Changes are debounced: a file is only reported once it's been quiet for a
+// moment, so it's never picked up half written, and files saved together
+// (say a vertex and a fragment shader) come out of the same poll().
+class FileWatcher {
+    public:
+        FileWatcher(
+            std::chrono::milliseconds debounce=std::chrono::milliseconds(100),
+            std::chrono::milliseconds poll_interval=std::chrono::milliseconds(250));
+        ~FileWatcher();
+
+        void watch(const std::filesystem::path& path);
+        // Files that changed since the last call. Never blocks, and costs an
+        // atomic load when nothing has.
+        std::vector<std::filesystem::path> poll();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        using Time = std::filesystem::file_time_type;
+
+        struct File {
+            // Only for polled files: what was last reported, and what the file said last time we looked
+            bool polled = false;
+            Time reported;
+            Time seen;
+        };
+
+        void run();
+        void wait(std::unique_lock<std::mutex>& lock, Clock::time_point until);
+        void wake();
+        void readEvents();
+        void statPolled(std::unique_lock<std::mutex>& lock);
+        void settle(Clock::time_point now);
+
+        std::chrono::milliseconds debounce_;
+        std::chrono::milliseconds poll_interval_;
+
+        int inotify_fd_ = -1;
+        // Wakes the thread out of waiting on inotify
+        int wake_fd_ = -1;
+        std::map<int, std::filesystem::path> dirs_;
+
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::map<std::filesystem::path, File> files_;
+        // When each file last changed, waiting to go quiet
+        std::map<std::filesystem::path, Clock::time_point> pending_;
+        std::set<std::filesystem::path> changed_;
+        std::atomic<bool> has_changes_;
+        bool running_ = false;
+        std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "HeadlessContext.h"
+
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <sstream>
+
+HeadlessContext::~HeadlessContext() {
+    if (display_ == EGL_NO_DISPLAY) {
+        return;
+    }
+
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (surface_ != EGL_NO_SURFACE) {
+        eglDestroySurface(display_, surface_);
+    }
+
+    if (context_ != EGL_NO_CONTEXT) {
+        eglDestroyContext(display_, context_);
+    }
+
+    eglTerminate(display_);
+}
+
+bool HeadlessContext::hasExtension(const char* extensions, const std::string& name) {
+    if (extensions == nullptr) {
+        return false;
+    }
+
+    std::istringstream s(extensions);
+    std::string ext;
+    while (s >> ext) {
+        if (ext == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Error HeadlessContext::setup() {
+    // Prefer the surfaceless platform so we never go looking for an X server
+    const char* client_exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(client_exts, "EGL_MESA_platform_surfaceless")) {
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display) {
+            display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+    }
+
+    if (display_ == EGL_NO_DISPLAY) {
+        display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (display_ == EGL_NO_DISPLAY) {
+        return "Unable to get an EGL display";
+    }
+
+    if (!eglInitialize(display_, NULL, NULL)) {
+        display_ = EGL_NO_DISPLAY;
+        return "Unable to initialize EGL";
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        return "EGL does not support desktop OpenGL";
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) || num_configs == 0) {
+        return "No suitable EGL config found";
+    }
+
+    // Match the context the windowed path asks GLFW for
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs);
+    if (context_ == EGL_NO_CONTEXT) {
+        return "Unable to create an OpenGL 4.1 core context through EGL";
+    }
+
+    const char* display_exts = eglQueryString(display_, EGL_EXTENSIONS);
+    if (!hasExtension(display_exts, "EGL_KHR_surfaceless_context")) {
+        const EGLint pbuffer_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attribs);
+        if (surface_ == EGL_NO_SURFACE) {
+            return "Unable to create an EGL pbuffer surface";
+        }
+    }
+
+    if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
+        return "Unable to make the EGL context current";
+    }
+
+    return {};
+}
@@ -0,0 +1,26 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <string>
+
+#include <EGL/egl.h>
+
+#include "Result.h"
+
+// An OpenGL context with no window, for rendering on machines without a display.
+// Uses a surfaceless context when the driver allows it and a 1x1 pbuffer otherwise;
+// either way everything we care about is drawn into App's framebuffer object.
+class HeadlessContext {
+    public:
+        ~HeadlessContext();
+        Error setup();
+
+    private:
+        bool hasExtension(const char* extensions, const std::string& name);
+
+        EGLDisplay display_ = EGL_NO_DISPLAY;
+        EGLContext context_ = EGL_NO_CONTEXT;
+        EGLSurface surface_ = EGL_NO_SURFACE;
+};
+
+#endif
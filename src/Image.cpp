@@ -1,58 +1,173 @@
 #include "Image.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
 #include "lodepng.h"
 
-Error Image::setup(std::filesystem::path& path, GLenum texture_unit) {
-    std::vector<unsigned char> image;
-    unsigned int width;
-    unsigned int height;
-    unsigned int errc = lodepng::decode(image, width, height, path);
+// Signature plus the IHDR chunk, all lodepng_inspect needs
+#define PNG_HEADER_SIZE 33
+
+Image::~Image() {
+    releaseBuffer();
+
+    if (tex_id_ != GL_FALSE) {
+        glDeleteTextures(1, &tex_id_);
+    }
+}
+
+void Image::releaseBuffer() {
+    if (pbo_ == GL_FALSE) {
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    if (mapped_) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        mapped_ = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // GL holds on to the storage until any upload from it has finished
+    glDeleteBuffers(1, &pbo_);
+    pbo_ = GL_FALSE;
+}
+
+Error Image::prepare(const std::filesystem::path& path, const ImageCache* cache) {
+    path_ = path;
+    cache_ = cache;
+    cached_ = cache ? cache->find(path) : nullptr;
+    from_cache_ = cached_ != nullptr;
+
+    if (cached_) {
+        loading_size_.set(cached_->getWidth(), cached_->getHeight());
+        return mapBuffer();
+    }
+
+    stamped_ = cache && !ImageCache::stamp(path, stamp_);
+
+    unsigned char header[PNG_HEADER_SIZE] = {};
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char*>(header), PNG_HEADER_SIZE);
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+    LodePNGState state;
+    lodepng_state_init(&state);
+    unsigned errc = lodepng_inspect(&width, &height, &state, header, static_cast<size_t>(file.gcount()));
+    lodepng_state_cleanup(&state);
+    if (errc != 0) {
+        return "PNG decoder error " + std::to_string(errc) + ": "+ lodepng_error_text(errc);
+    }
+
+    loading_size_.set(width, height);
+
+    return mapBuffer();
+}
+
+Error Image::mapBuffer() {
+    GLsizeiptr size = static_cast<GLsizeiptr>(loading_size_.getWidth<size_t>() * loading_size_.getHeight<size_t>() * 4);
+    releaseBuffer();
+    glGenBuffers(1, &pbo_);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    mapped_ = static_cast<unsigned char*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!mapped_) {
+        releaseBuffer();
+        return "Unable to map a " + std::to_string(size) + " byte upload buffer";
+    }
+
+    return {};
+}
+
+Error Image::decode() {
+    // Already flipped, so it's a straight copy
+    if (cached_) {
+        std::memcpy(mapped_, cached_->getPixels(), loading_size_.getWidth<size_t>() * loading_size_.getHeight<size_t>() * 4);
+        cached_.reset();
+        return {};
+    }
+
+    unsigned char* decoded = nullptr;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned errc = lodepng_decode32_file(&decoded, &width, &height, path_.string().c_str());
     if (errc != 0) {
+        std::free(decoded);
         return "PNG decoder error " + std::to_string(errc) + ": "+ lodepng_error_text(errc);
     }
 
-    size_.set(width, height);
+    if (width != loading_size_.getWidth<unsigned int>() || height != loading_size_.getHeight<unsigned int>()) {
+        std::free(decoded);
+        return "Image changed while loading";
+    }
+
+    // Flip upside down on the way in (PNG's coordinate system is upside down to OpenGL's)
+    size_t stride = static_cast<size_t>(width) * 4;
+    for (size_t row = 0; row < height; row++) {
+        std::memcpy(mapped_ + (height - 1 - row) * stride, decoded + row * stride, stride);
+    }
 
-    std::vector<unsigned char> flipped;
-    int widthi = size_.getWidth<int>();
-    int heighti = size_.getHeight<int>();
-    for (int row = heighti - 1; row >= 0; row--) {
-        int offset = row * (widthi * 4);
-        flipped.insert(flipped.end(), image.begin() + offset, image.begin() + offset + (widthi * 4));
+    // Not being able to cache only costs the next run time
+    if (cache_ && stamped_) {
+        Error err = cache_->store(path_, stamp_, decoded, width, height);
+        if (err) {
+            std::cerr << "Warning: unable to cache " << path_.string() << ": " << err.value() << std::endl;
+        }
     }
+    std::free(decoded);
 
+    return {};
+}
+
+void Image::upload() {
     if (tex_id_ == GL_FALSE) {
         glGenTextures(1, &tex_id_);
     }
 
-    texture_unit_ = texture_unit;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    mapped_ = nullptr;
 
-    // Store the previous active texture so we can revert to it
-    GLint prev_active = 0;
-    glGetIntegeri_v(GL_ACTIVE_TEXTURE, 1, &prev_active);
+    GLsizei width = loading_size_.getWidth<GLsizei>();
+    GLsizei height = loading_size_.getHeight<GLsizei>();
 
-    glActiveTexture(texture_unit);
+    // The copy out of the buffer runs on the GPU's schedule, frames sampling
+    // the old pixels in the meantime aren't held up
     glBindTexture(GL_TEXTURE_2D, tex_id_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthi, heighti, 0, GL_RGBA, GL_UNSIGNED_BYTE, &flipped[0]);
+    if (initialized_ && width == size_.getWidth<GLsizei>() && height == size_.getHeight<GLsizei>()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    glActiveTexture(prev_active);
+    releaseBuffer();
 
+    size_ = loading_size_;
     initialized_ = true;
+}
 
-    return {};
+void Image::cancel() {
+    cached_.reset();
+    releaseBuffer();
 }
 
-GLuint Image::getID() const {
-    return tex_id_;
+bool Image::isCached() const {
+    return from_cache_;
 }
 
-GLenum Image::getTextureUnit() const {
-    return texture_unit_;
+GLuint Image::getID() const {
+    return tex_id_;
 }
 
 Size Image::getSize() const {
@@ -62,3 +177,5 @@ Size Image::getSize() const {
 bool Image::isInitialized() const {
     return initialized_;
 }
+
+#undef PNG_HEADER_SIZE
@@ -4,23 +4,56 @@
 #include "Result.h"
 
 #include <filesystem>
+#include <memory>
 
 #include <GL/glew.h>
 
 #include "Size.h"
+#include "ImageCache.h"
 
+// A PNG texture, (re)loaded in three steps so decoding, the slow part, can run on
+// any thread while GL calls stay on the one with the context. Pixels are
+// decoded straight into a mapped pixel unpack buffer, flipped as the rows are
+// written, so the only client side copy is lodepng's own output. With a
+// cache, images decoded on an earlier run are copied straight from the
+// mapped cache file instead and lodepng isn't involved at all.
 class Image {
     public:
-        Error setup(std::filesystem::path& path, GLenum texture_unit);
+        ~Image();
+
+        // Size the image from the cache or its header and map a buffer for it. GL thread.
+        Error prepare(const std::filesystem::path& path, const ImageCache* cache=nullptr);
+        // Decode (or copy from the cache) into the mapped buffer, storing what was
+        // decoded in the cache. Touches no GL state.
+        Error decode();
+        // Whether the last prepare() found the image in the cache
+        bool isCached() const;
+        // Create the texture from the buffer decode() filled, or refill it. GL thread.
+        void upload();
+        // Give up on a load that failed to decode, keeping the texture as it was. GL thread.
+        void cancel();
+
         GLuint getID() const;
         Size getSize() const;
         bool isInitialized() const;
-        GLenum getTextureUnit() const;
 
     private:
+        Error mapBuffer();
+        void releaseBuffer();
+
+        std::filesystem::path path_;
+        const ImageCache* cache_ = nullptr;
+        std::unique_ptr<ImageCache::Entry> cached_;
+        // Taken before decoding, so what's stored is paired with the version that was read
+        ImageCache::Stamp stamp_;
+        bool stamped_ = false;
+        bool from_cache_ = false;
+        GLuint pbo_ = GL_FALSE;
+        unsigned char* mapped_ = nullptr;
         GLuint tex_id_ = GL_FALSE;
-        GLenum texture_unit_ = GL_TEXTURE0;
         bool initialized_ = false;
+        // Size of the texture, and of what's being loaded into it
         Size size_;
+        Size loading_size_;
 };
 #endif
@@ -0,0 +1,183 @@
+#include "ImageCache.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AtomicWrite.h"
+
+#define CACHE_MAGIC "ILLUMIMG"
+#define CACHE_VERSION 1
+
+// Followed by the source path (path_size bytes), then width * height RGBA pixels
+struct ImageCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t path_size;
+    uint64_t source_size;
+    int64_t source_mtime;
+};
+
+ImageCache::Entry::~Entry() {
+    if (map_) {
+        munmap(map_, map_size_);
+    }
+}
+
+const unsigned char* ImageCache::Entry::getPixels() const {
+    return pixels_;
+}
+
+unsigned int ImageCache::Entry::getWidth() const {
+    return width_;
+}
+
+unsigned int ImageCache::Entry::getHeight() const {
+    return height_;
+}
+
+ImageCache::ImageCache(const std::filesystem::path& dir) : dir_(dir) {}
+
+std::filesystem::path ImageCache::defaultDir() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0] != '\0') {
+        return std::filesystem::path(xdg) / "illum";
+    }
+
+    const char* home = std::getenv("HOME");
+    return std::filesystem::path(home ? home : ".") / ".cache" / "illum";
+}
+
+std::filesystem::path ImageCache::entryPath(const std::filesystem::path& path) const {
+    std::ostringstream name;
+    name << std::hex << std::hash<std::string>()(path.string()) << ".rgba";
+    return dir_ / name.str();
+}
+
+bool ImageCache::Stamp::operator==(const Stamp& other) const {
+    return size == other.size && mtime == other.mtime;
+}
+
+Error ImageCache::stamp(const std::filesystem::path& path, Stamp& stamp) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return ec.message();
+    }
+
+    std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return ec.message();
+    }
+
+    stamp.size = static_cast<uint64_t>(size);
+    stamp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+
+    return {};
+}
+
+void ImageCache::describe(const std::filesystem::path& path, const Stamp& stamp, Header& header) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.path_size = static_cast<uint32_t>(path.string().size());
+    header.source_size = stamp.size;
+    header.source_mtime = stamp.mtime;
+}
+
+std::unique_ptr<ImageCache::Entry> ImageCache::find(const std::filesystem::path& path) const {
+    Stamp on_disk;
+    if (stamp(path, on_disk)) {
+        return nullptr;
+    }
+
+    Header expected;
+    describe(path, on_disk, expected);
+
+    int fd = open(entryPath(path).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    size_t map_size = 0;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+        map_size = static_cast<size_t>(st.st_size);
+        map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping keeps the file open for us
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->map_ = map;
+    entry->map_size_ = map_size;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(map);
+    Header header;
+    std::memcpy(&header, bytes, sizeof(header));
+
+    const std::string source = path.string();
+    size_t pixels_size = static_cast<size_t>(header.width) * header.height * 4;
+    bool current = std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+        && header.version == expected.version
+        && header.source_size == expected.source_size
+        && header.source_mtime == expected.source_mtime
+        && header.path_size == expected.path_size
+        && map_size == sizeof(Header) + header.path_size + pixels_size
+        && std::memcmp(bytes + sizeof(Header), source.data(), source.size()) == 0;
+    if (!current) {
+        return nullptr;
+    }
+
+    entry->pixels_ = bytes + sizeof(Header) + header.path_size;
+    entry->width_ = header.width;
+    entry->height_ = header.height;
+
+    // It's about to be read front to back, start reading ahead now
+    madvise(map, map_size, MADV_SEQUENTIAL);
+    madvise(map, map_size, MADV_WILLNEED);
+
+    return entry;
+}
+
+Error ImageCache::store(const std::filesystem::path& path, const Stamp& stamp, const unsigned char* pixels, unsigned int width, unsigned int height) const {
+    // Saved again while it was being decoded, these pixels may be from either version
+    Stamp current;
+    Error err = ImageCache::stamp(path, current);
+    if (err || !(current == stamp)) {
+        return {};
+    }
+
+    Header header;
+    describe(path, stamp, header);
+    header.width = width;
+    header.height = height;
+
+    return writeAtomically(entryPath(path), [&header, &path, pixels, width, height](std::ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(path.string().data(), static_cast<std::streamsize>(header.path_size));
+
+        // Bottom row first, the way GL wants them
+        std::streamsize stride = static_cast<std::streamsize>(width) * 4;
+        for (size_t row = height; row > 0; row--) {
+            out.write(reinterpret_cast<const char*>(pixels) + (row - 1) * static_cast<size_t>(stride), stride);
+        }
+    });
+}
+
+#undef CACHE_MAGIC
+#undef CACHE_VERSION
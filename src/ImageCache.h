@@ -0,0 +1,67 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "Result.h"
+
+// Decoded images kept on disk so later runs can skip PNG decoding. Each
+// source path gets one file: a small header recording the source's size and
+// modification time, then raw RGBA rows bottom first, ready to upload. An
+// entry that no longer matches its source is a miss and is overwritten by
+// the next store, so the cache never holds more than one copy per image.
+class ImageCache {
+    public:
+        // A cache file mapped into memory, valid while the Entry lives
+        class Entry {
+            public:
+                ~Entry();
+                const unsigned char* getPixels() const;
+                unsigned int getWidth() const;
+                unsigned int getHeight() const;
+
+            private:
+                friend class ImageCache;
+                Entry() = default;
+
+                void* map_ = nullptr;
+                size_t map_size_ = 0;
+                const unsigned char* pixels_ = nullptr;
+                unsigned int width_ = 0;
+                unsigned int height_ = 0;
+        };
+
+        // What an entry is checked against: the source's size and modification time
+        struct Stamp {
+            uint64_t size = 0;
+            int64_t mtime = 0;
+
+            bool operator==(const Stamp& other) const;
+        };
+
+        ImageCache(const std::filesystem::path& dir);
+
+        // $XDG_CACHE_HOME/illum, else ~/.cache/illum
+        static std::filesystem::path defaultDir();
+
+        // The cached pixels for path if they're still current, or nullptr
+        std::unique_ptr<Entry> find(const std::filesystem::path& path) const;
+        static Error stamp(const std::filesystem::path& path, Stamp& stamp);
+        // Rows top first, as lodepng decodes them. stamp is the source's from before
+        // it was decoded, if it's changed since then nothing is stored. Safe to call
+        // from several threads.
+        Error store(const std::filesystem::path& path, const Stamp& stamp, const unsigned char* pixels, unsigned int width, unsigned int height) const;
+
+    private:
+        struct Header;
+
+        std::filesystem::path entryPath(const std::filesystem::path& path) const;
+        static void describe(const std::filesystem::path& path, const Stamp& stamp, Header& header);
+
+        std::filesystem::path dir_;
+};
+
+#endif
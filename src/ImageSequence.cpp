@@ -0,0 +1,232 @@
+#include "ImageSequence.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "lodepng.h"
+
+// Uploads are cheap next to decoding, but a burst of them (say, after a seek)
+// shouldn't land in a single frame
+#define MAX_UPLOADS_PER_FRAME 4
+
+ImageSequence::ImageSequence(size_t threads, size_t budget_bytes)
+    : budget_bytes_(budget_bytes), max_in_flight_(threads * 2), pool_(threads, threads * 2) {}
+
+ImageSequence::~ImageSequence() {
+    pool_.wait();
+
+    if (pbo_ != GL_FALSE) {
+        glDeleteBuffers(1, &pbo_);
+    }
+
+    if (tex_id_ != GL_FALSE) {
+        glDeleteTextures(1, &tex_id_);
+    }
+}
+
+Error ImageSequence::setup(const std::filesystem::path& dir, double fps) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (entry.is_regular_file() && ext == ".png") {
+            paths_.push_back(entry.path());
+        }
+    }
+    if (ec) {
+        return "Unable to list " + dir.string() + ": " + ec.message();
+    }
+
+    if (paths_.empty()) {
+        return "No PNG files in " + dir.string();
+    }
+
+    // Zero padded numbering sorts the same as the numbers
+    std::sort(paths_.begin(), paths_.end());
+    fps_ = fps;
+
+    // Every frame has to match the first, and only its header is needed to size things
+    std::vector<unsigned char> png;
+    unsigned errc = lodepng::load_file(png, paths_[0].string());
+    unsigned width = 0;
+    unsigned height = 0;
+    lodepng::State state;
+    if (errc == 0) {
+        errc = lodepng_inspect(&width, &height, &state, png.data(), png.size());
+    }
+    if (errc != 0) {
+        return "PNG decoder error " + std::to_string(errc) + " in " + paths_[0].string() + ": " + lodepng_error_text(errc);
+    }
+    size_.set(width, height);
+
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+    size_t frame_bytes = static_cast<size_t>(width) * height * 4;
+    size_t layers = std::min(budget_bytes_ / frame_bytes, paths_.size());
+    layers = std::min(layers, static_cast<size_t>(std::max(max_layers, 1)));
+    if (layers < 2 && paths_.size() > 1) {
+        return "Memory budget too small for two " + std::to_string(width) + "x" + std::to_string(height) + " frames";
+    }
+    layers = std::max<size_t>(layers, 1);
+
+    layer_frames_.assign(layers, NONE);
+    pending_.assign(layers, NONE);
+
+    glGenTextures(1, &tex_id_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex_id_);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, size_.getWidth<GLsizei>(), size_.getHeight<GLsizei>(), static_cast<GLsizei>(layers));
+    } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size_.getWidth<GLsizei>(), size_.getHeight<GLsizei>(), static_cast<GLsizei>(layers), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenBuffers(1, &pbo_);
+
+    return {};
+}
+
+void ImageSequence::request(size_t layer, size_t frame) {
+    pending_[layer] = frame;
+    in_flight_++;
+
+    unsigned int width = size_.getWidth<unsigned int>();
+    unsigned int height = size_.getHeight<unsigned int>();
+    pool_.submit([this, layer, frame, width, height, path = paths_[frame]]() {
+        Decoded decoded{layer, frame, {}, {}};
+
+        unsigned int w = 0;
+        unsigned int h = 0;
+        unsigned errc = lodepng::decode(decoded.pixels, w, h, path.string());
+        if (errc != 0) {
+            decoded.err = "PNG decoder error " + std::to_string(errc) + " in " + path.string() + ": " + lodepng_error_text(errc);
+        } else if (w != width || h != height) {
+            decoded.err = path.string() + " is " + std::to_string(w) + "x" + std::to_string(h) + ", not the sequence's "
+                + std::to_string(width) + "x" + std::to_string(height);
+        } else {
+            // Flip upside down (PNG's coordinate system is upside down to OpenGL's)
+            size_t stride = static_cast<size_t>(width) * 4;
+            for (size_t top = 0; top < height / 2; top++) {
+                size_t bottom = height - 1 - top;
+                std::swap_ranges(
+                    decoded.pixels.begin() + static_cast<std::ptrdiff_t>(top * stride),
+                    decoded.pixels.begin() + static_cast<std::ptrdiff_t>((top + 1) * stride),
+                    decoded.pixels.begin() + static_cast<std::ptrdiff_t>(bottom * stride));
+            }
+        }
+
+        std::lock_guard guard(mutex_);
+        ready_.push_back(std::move(decoded));
+    });
+}
+
+void ImageSequence::upload(const Decoded& decoded) {
+    GLsizeiptr size = static_cast<GLsizeiptr>(decoded.pixels.size());
+
+    // Orphaning hands us fresh storage, so this never waits on the previous upload's copy
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void* dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dest) {
+        std::memcpy(dest, decoded.pixels.data(), decoded.pixels.size());
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tex_id_);
+        glTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(decoded.layer),
+            size_.getWidth<GLsizei>(), size_.getHeight<GLsizei>(), 1,
+            GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void ImageSequence::update(double t) {
+    if (paths_.empty()) {
+        return;
+    }
+
+    size_t frames = paths_.size();
+    size_t layers = layer_frames_.size();
+    size_t pos = static_cast<size_t>(std::max(std::floor(t * fps_), 0.0));
+
+    {
+        std::lock_guard guard(mutex_);
+        for (auto& decoded : ready_) {
+            waiting_.push_back(std::move(decoded));
+        }
+        ready_.clear();
+    }
+
+    size_t uploads = 0;
+    while (!waiting_.empty() && uploads < MAX_UPLOADS_PER_FRAME) {
+        Decoded& decoded = waiting_.front();
+
+        // The window may have moved on and given the layer to another frame
+        if (pending_[decoded.layer] == decoded.frame) {
+            pending_[decoded.layer] = NONE;
+
+            // A bad frame still takes its layer, or we'd be decoding it forever
+            layer_frames_[decoded.layer] = decoded.frame;
+            if (decoded.err) {
+                std::cerr << "Error loading sequence frame: " << decoded.err.value() << std::endl;
+            } else {
+                upload(decoded);
+                uploads++;
+            }
+        }
+
+        waiting_.pop_front();
+        in_flight_--;
+    }
+
+    // Counting positions rather than frames keeps every layer in the window
+    // distinct when it wraps past the end. Nearest first, so the frames due
+    // soonest get decoded soonest.
+    for (size_t ahead = 0; ahead < layers && in_flight_ < max_in_flight_; ahead++) {
+        size_t frame = (pos + ahead) % frames;
+        size_t layer = (pos + ahead) % layers;
+        if (layer_frames_[layer] != frame && pending_[layer] != frame) {
+            request(layer, frame);
+        }
+    }
+
+    size_t layer = pos % layers;
+    if (layer_frames_[layer] == pos % frames) {
+        layer_ = static_cast<GLint>(layer);
+        frame_ = static_cast<GLint>(pos % frames);
+    }
+}
+
+GLuint ImageSequence::getID() const {
+    return tex_id_;
+}
+
+Size ImageSequence::getSize() const {
+    return size_;
+}
+
+GLint ImageSequence::getLayer() const {
+    return layer_;
+}
+
+GLint ImageSequence::getFrame() const {
+    return frame_;
+}
+
+size_t ImageSequence::getFrameCount() const {
+    return paths_.size();
+}
+
+size_t ImageSequence::getLayerCount() const {
+    return layer_frames_.size();
+}
+
+#undef MAX_UPLOADS_PER_FRAME
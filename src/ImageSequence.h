@@ -0,0 +1,77 @@
+#ifndef IMAGE_SEQUENCE_H
+#define IMAGE_SEQUENCE_H
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Result.h"
+#include "Size.h"
+#include "ThreadPool.h"
+
+// A directory of same-sized PNGs played back as a flipbook through a texture
+// array. Only as many layers as fit the memory budget are allocated, and they
+// form a sliding window over the frames coming up: workers decode ahead, the
+// render thread uploads what's finished through a pixel unpack buffer, and
+// frames behind the playhead give up their layers to frames ahead of it.
+// Sequences that fit in the budget are decoded once and stay resident.
+class ImageSequence {
+    public:
+        ImageSequence(size_t threads, size_t budget_bytes);
+        ~ImageSequence();
+
+        Error setup(const std::filesystem::path& dir, double fps);
+        // Advance to the frame due at t (looping) and stream toward the frames after it.
+        // Uploads land on the texture bound to the active unit.
+        void update(double t);
+
+        GLuint getID() const;
+        Size getSize() const;
+        // Where the current frame is. Holds the last frame shown if it hasn't been decoded yet.
+        GLint getLayer() const;
+        GLint getFrame() const;
+        size_t getFrameCount() const;
+        size_t getLayerCount() const;
+
+    private:
+        static constexpr size_t NONE = static_cast<size_t>(-1);
+
+        struct Decoded {
+            size_t layer;
+            size_t frame;
+            std::vector<unsigned char> pixels;
+            Error err;
+        };
+
+        void request(size_t layer, size_t frame);
+        void upload(const Decoded& decoded);
+
+        std::vector<std::filesystem::path> paths_;
+        double fps_ = 0;
+        Size size_;
+        size_t budget_bytes_;
+        size_t max_in_flight_;
+
+        GLuint tex_id_ = GL_FALSE;
+        GLuint pbo_ = GL_FALSE;
+
+        // Render thread only: which frame each layer holds or is waiting on
+        std::vector<size_t> layer_frames_;
+        std::vector<size_t> pending_;
+        std::deque<Decoded> waiting_;
+        size_t in_flight_ = 0;
+        GLint layer_ = 0;
+        GLint frame_ = -1;
+
+        std::mutex mutex_;
+        std::vector<Decoded> ready_;
+
+        // Last, so workers are joined before anything they touch goes away
+        ThreadPool pool_;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "lodepng.h"
+
+ImageWriter::ImageWriter(size_t threads, size_t max_queued) : written_(0), pool_(threads, max_queued) {}
+
+void ImageWriter::write(const std::filesystem::path& dest, std::vector<unsigned char> pixels, unsigned int width, unsigned int height) {
+    started();
+    pool_.submit(makeJob(dest, std::move(pixels), width, height));
+}
+
+bool ImageWriter::tryWrite(const std::filesystem::path& dest, const unsigned char* pixels, unsigned int width, unsigned int height) {
+    // Checked first so a frame that's turned away isn't copied for nothing
+    if (pool_.isFull()) {
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+    started();
+    return pool_.trySubmit(makeJob(dest, std::vector<unsigned char>(pixels, pixels + size), width, height));
+}
+
+void ImageWriter::started() {
+    std::lock_guard guard(timing_mutex_);
+    if (!started_) {
+        first_write_ = Clock::now();
+        started_ = true;
+    }
+}
+
+ThreadPool::Job ImageWriter::makeJob(const std::filesystem::path& dest, std::vector<unsigned char> pixels, unsigned int width, unsigned int height) {
+    return [this, dest, pixels = std::move(pixels), width, height]() mutable {
+        encode(dest, pixels, width, height);
+
+        std::lock_guard guard(timing_mutex_);
+        last_done_ = Clock::now();
+        written_++;
+    };
+}
+
+void ImageWriter::wait() {
+    pool_.wait();
+}
+
+size_t ImageWriter::getWritten() const {
+    return written_.load();
+}
+
+size_t ImageWriter::getThreadCount() const {
+    return pool_.getThreadCount();
+}
+
+double ImageWriter::getThroughput() {
+    std::lock_guard guard(timing_mutex_);
+    std::chrono::duration<double> elapsed = last_done_ - first_write_;
+    if (!started_ || elapsed.count() <= 0) {
+        return 0;
+    }
+
+    return static_cast<double>(written_.load()) / elapsed.count();
+}
+
+void ImageWriter::encode(const std::filesystem::path& dest, std::vector<unsigned char>& pixels, unsigned int width, unsigned int height) {
+    // Flip upside down (PNG's coordinate system is upside down to OpenGL's)
+    size_t stride = static_cast<size_t>(width) * 4;
+    for (size_t top = 0; top < height / 2; top++) {
+        size_t bottom = height - 1 - top;
+        std::swap_ranges(
+            pixels.begin() + static_cast<std::ptrdiff_t>(top * stride),
+            pixels.begin() + static_cast<std::ptrdiff_t>((top + 1) * stride),
+            pixels.begin() + static_cast<std::ptrdiff_t>(bottom * stride));
+    }
+
+    unsigned errc = lodepng::encode(dest, pixels, width, height);
+    if (errc) {
+        std::cerr << "Error writing " << dest << ": encoder error " << errc << ": " << lodepng_error_text(errc) << std::endl;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Flips and PNG encodes frames on background threads so the render thread
+// only pays for handing over the pixels. write() blocks once max_queued frames
+// are waiting, which bounds memory and slows the producer down to the rate the
+// encoders can sustain. tryWrite() is for the live render loop, which can't
+// wait: it turns the frame away instead.
+class ImageWriter {
+    public:
+        ImageWriter(size_t threads=1, size_t max_queued=8);
+
+        // Pixels are RGBA8 rows, bottom row first (as read from OpenGL)
+        void write(const std::filesystem::path& dest, std::vector<unsigned char> pixels, unsigned int width, unsigned int height);
+        // Copies the pixels only if there's room in the queue, false if there wasn't
+        bool tryWrite(const std::filesystem::path& dest, const unsigned char* pixels, unsigned int width, unsigned int height);
+        void wait();
+
+        size_t getWritten() const;
+        size_t getThreadCount() const;
+        // Frames encoded per second of wall time between the first write and the last finished encode
+        double getThroughput();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void started();
+        ThreadPool::Job makeJob(const std::filesystem::path& dest, std::vector<unsigned char> pixels, unsigned int width, unsigned int height);
+        static void encode(const std::filesystem::path& dest, std::vector<unsigned char>& pixels, unsigned int width, unsigned int height);
+
+        std::atomic<size_t> written_;
+        std::mutex timing_mutex_;
+        Clock::time_point first_write_;
+        Clock::time_point last_done_;
+        bool started_ = false;
+        ThreadPool pool_;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "JoystickBuffer.h"
+
+#include <algorithm>
+#include <sstream>
+
+JoystickBuffer::~JoystickBuffer() {
+    if (ubo_ != GL_FALSE) {
+        glDeleteBuffers(1, &ubo_);
+    }
+}
+
+void JoystickBuffer::setup(const std::vector<std::shared_ptr<Joystick>>& joysticks, GLuint binding) {
+    joysticks_ = joysticks;
+    binding_ = binding;
+
+    size_t count = 0;
+    for (const auto& joy : joysticks_) {
+        count += joy->getOutputs().size();
+    }
+
+    // GLSL doesn't allow empty arrays
+    controls_.assign(std::max<size_t>(count, 1), Control{});
+
+    if (ubo_ == GL_FALSE) {
+        glGenBuffers(1, &ubo_);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(controls_.size() * sizeof(Control)), controls_.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_, ubo_);
+}
+
+void JoystickBuffer::upload() {
+    size_t i = 0;
+    for (const auto& joy : joysticks_) {
+        for (const auto& kv : joy->getOutputs()) {
+            const JoystickOutput& ctrl = kv.second;
+            Control& control = controls_[i++];
+
+            control.value = ctrl.value;
+            control.time = (float)ctrl.time;
+            control.time_total = (float)ctrl.time_total;
+            control.pressed = ctrl.pressed ? 1 : 0;
+            control.pressed_new = ctrl.pressed_new ? 1 : 0;
+        }
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(controls_.size() * sizeof(Control)), controls_.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+std::string JoystickBuffer::getHeader() const {
+    std::ostringstream s;
+    s << "// Generated by illum for --joystick-ubo\n"
+      << "struct JoystickControl {\n"
+      << "    float value;\n"
+      << "    float time;\n"
+      << "    float timeTotal;\n"
+      << "    bool pressed;\n"
+      << "    bool pressedNew;\n"
+      << "};\n"
+      << "\n"
+      << "layout(std140) uniform " << BLOCK_NAME << " {\n"
+      << "    JoystickControl joysticks[" << controls_.size() << "];\n"
+      << "};\n"
+      << "\n";
+
+    // Same names as the individual uniforms, so existing shaders only need to swap declarations for the include
+    size_t i = 0;
+    int joy_idx = 1;
+    for (const auto& joy : joysticks_) {
+        for (const auto& kv : joy->getOutputs()) {
+            const std::string base = "j" + std::to_string(joy_idx) + kv.first;
+            const std::string control = "joysticks[" + std::to_string(i++) + "]";
+
+            s << "#define " << base << " " << control << ".value\n"
+              << "#define " << base << "Pressed " << control << ".pressed\n"
+              << "#define " << base << "PressedNew " << control << ".pressedNew\n"
+              << "#define " << base << "Time " << control << ".time\n"
+              << "#define " << base << "TimeTotal " << control << ".timeTotal\n";
+        }
+
+        joy_idx++;
+    }
+
+    return s.str();
+}
+
+GLuint JoystickBuffer::getBinding() const {
+    return binding_;
+}
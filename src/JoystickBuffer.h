@@ -0,0 +1,46 @@
+#ifndef JOYSTICK_BUFFER_H
+#define JOYSTICK_BUFFER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Joystick.h"
+
+// Packs every output of every joystick into one std140 uniform block so the
+// whole controller state goes to the GPU in a single buffer update per frame.
+// getHeader() generates the GLSL declaring the block plus a #define for each
+// of the usual per-control uniform names (j1button_a, j1button_aPressed, ...).
+class JoystickBuffer {
+    public:
+        static constexpr const char* BLOCK_NAME = "Joysticks";
+        static constexpr const char* HEADER_NAME = "joysticks.glsl";
+
+        ~JoystickBuffer();
+
+        void setup(const std::vector<std::shared_ptr<Joystick>>& joysticks, GLuint binding);
+        void upload();
+        std::string getHeader() const;
+        GLuint getBinding() const;
+
+    private:
+        // Mirrors the std140 layout of the GLSL struct in getHeader()
+        struct Control {
+            GLfloat value;
+            GLfloat time;
+            GLfloat time_total;
+            GLint pressed;
+            GLint pressed_new;
+            GLint padding[3];
+        };
+        static_assert(sizeof(Control) == 32, "JoystickBuffer::Control must match its std140 layout");
+
+        std::vector<std::shared_ptr<Joystick>> joysticks_;
+        std::vector<Control> controls_;
+        GLuint ubo_ = GL_FALSE;
+        GLuint binding_ = 0;
+};
+
+#endif
@@ -5,6 +5,11 @@
 #include "GLFW/glfw3.h"
 
 void JoystickManager::update() {
+    // Nothing to map, don't bother GLFW (which may not even be initialized when headless)
+    if (joysticks_.empty()) {
+        return;
+    }
+
     // Gather connected joysticks from GLFW
     std::vector<int> available_devices;
     for (int i=GLFW_JOYSTICK_1; i <= GLFW_JOYSTICK_LAST; i++) {
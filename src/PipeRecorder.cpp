@@ -0,0 +1,220 @@
+#include "PipeRecorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+PipeRecorder::PipeRecorder(size_t max_queued) : max_queued_(max_queued), written_(0), dropped_(0) {}
+
+PipeRecorder::~PipeRecorder() {
+    close();
+}
+
+Error PipeRecorder::parseFormat(const std::string& name, Format& format) {
+    if (name == "y4m") {
+        format = Format::Y4M;
+    } else if (name == "rgba") {
+        format = Format::RGBA;
+    } else {
+        return "unknown recording format '" + name + "', expected y4m or rgba";
+    }
+
+    return {};
+}
+
+Error PipeRecorder::open(const std::string& path, Format format, unsigned int width, unsigned int height, unsigned int fps, bool blocking) {
+    if (path == "-") {
+        out_ = stdout;
+        close_out_ = false;
+    } else {
+        // Opening a FIFO blocks until the encoder on the other end opens it too
+        out_ = fopen(path.c_str(), "wb");
+        if (!out_) {
+            return "Error opening " + path + " - " + std::strerror(errno);
+        }
+        close_out_ = true;
+    }
+
+    format_ = format;
+    width_ = width;
+    height_ = height;
+    blocking_ = blocking;
+
+    if (format_ == Format::Y4M) {
+        // 4:2:0 with chroma centered between luma samples, which is what 2x2 averaging gives us
+        fprintf(out_, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width_, height_, fps);
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]{ run(); });
+
+    return {};
+}
+
+void PipeRecorder::close() {
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard guard(mutex_);
+        running_ = false;
+    }
+
+    // Whatever is queued still gets written
+    frame_ready_.notify_all();
+    thread_.join();
+
+    fflush(out_);
+    if (close_out_) {
+        fclose(out_);
+    }
+    out_ = nullptr;
+}
+
+bool PipeRecorder::push(const unsigned char* pixels) {
+    std::unique_lock lock(mutex_);
+    if (blocking_) {
+        frame_taken_.wait(lock, [this]{ return frames_.size() < max_queued_ || !running_; });
+    }
+
+    if (!running_ || frames_.size() >= max_queued_) {
+        dropped_++;
+        return false;
+    }
+
+    // Reuse buffers the writer is done with rather than allocating a frame each time
+    std::vector<unsigned char> buffer;
+    if (!free_buffers_.empty()) {
+        buffer = std::move(free_buffers_.back());
+        free_buffers_.pop_back();
+    }
+    lock.unlock();
+
+    buffer.assign(pixels, pixels + static_cast<size_t>(width_) * height_ * 4);
+
+    lock.lock();
+    frames_.push_back(std::move(buffer));
+    lock.unlock();
+    frame_ready_.notify_one();
+
+    return true;
+}
+
+void PipeRecorder::drop() {
+    dropped_++;
+}
+
+size_t PipeRecorder::getWritten() const {
+    return written_.load();
+}
+
+size_t PipeRecorder::getDropped() const {
+    return dropped_.load();
+}
+
+void PipeRecorder::run() {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        frame_ready_.wait(lock, [this]{ return !frames_.empty() || !running_; });
+        if (frames_.empty()) {
+            return;
+        }
+
+        std::vector<unsigned char> frame = std::move(frames_.front());
+        frames_.pop_front();
+        lock.unlock();
+        frame_taken_.notify_all();
+
+        bool ok = writeFrame(frame);
+
+        lock.lock();
+        free_buffers_.push_back(std::move(frame));
+        if (!ok) {
+            // The reader went away, there's no point keeping the queue alive
+            std::cerr << "Error recording: " << std::strerror(errno) << std::endl;
+            dropped_ += frames_.size();
+            frames_.clear();
+            running_ = false;
+            lock.unlock();
+            frame_taken_.notify_all();
+            return;
+        }
+        lock.unlock();
+
+        written_++;
+    }
+}
+
+bool PipeRecorder::writeFrame(const std::vector<unsigned char>& pixels) {
+    if (format_ == Format::Y4M) {
+        return writeY4M(pixels);
+    }
+
+    return writeRGBA(pixels);
+}
+
+bool PipeRecorder::writeRGBA(const std::vector<unsigned char>& pixels) {
+    // Encoders expect the top row first
+    size_t stride = static_cast<size_t>(width_) * 4;
+    for (size_t row = height_; row-- > 0;) {
+        if (fwrite(&pixels[row * stride], 1, stride, out_) != stride) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PipeRecorder::writeY4M(const std::vector<unsigned char>& pixels) {
+    size_t w = width_;
+    size_t h = height_;
+    size_t cw = (w + 1) / 2;
+    size_t ch = (h + 1) / 2;
+    yuv_.resize(w * h + 2 * cw * ch);
+
+    unsigned char* y_plane = yuv_.data();
+    unsigned char* u_plane = y_plane + w * h;
+    unsigned char* v_plane = u_plane + cw * ch;
+
+    // BT.601 limited range, integer approximation
+    auto pixel = [&pixels, w, h](size_t x, size_t y) {
+        return &pixels[((h - 1 - y) * w + x) * 4];
+    };
+
+    for (size_t y = 0; y < h; y++) {
+        for (size_t x = 0; x < w; x++) {
+            const unsigned char* p = pixel(x, y);
+            int r = p[0], g = p[1], b = p[2];
+            y_plane[y * w + x] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    for (size_t cy = 0; cy < ch; cy++) {
+        for (size_t cx = 0; cx < cw; cx++) {
+            // Average the 2x2 block, clamping at odd right/bottom edges
+            int r = 0, g = 0, b = 0;
+            for (size_t dy = 0; dy < 2; dy++) {
+                for (size_t dx = 0; dx < 2; dx++) {
+                    const unsigned char* p = pixel(std::min(cx * 2 + dx, w - 1), std::min(cy * 2 + dy, h - 1));
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+
+            u_plane[cy * cw + cx] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v_plane[cy * cw + cx] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    if (fputs("FRAME\n", out_) == EOF) {
+        return false;
+    }
+
+    return fwrite(yuv_.data(), 1, yuv_.size(), out_) == yuv_.size();
+}
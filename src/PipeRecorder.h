@@ -0,0 +1,66 @@
+#ifndef PIPE_RECORDER_H
+#define PIPE_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Result.h"
+
+// Streams rendered frames to stdout or a file/named pipe for an external encoder,
+// either as YUV4MPEG2 (4:2:0) or as raw top-down RGBA. Conversion and writing
+// happen on a background thread behind a bounded queue; when the queue is full
+// a frame is dropped (and counted) rather than stalling the render thread,
+// unless the recorder is blocking, in which case push() waits for room.
+class PipeRecorder {
+    public:
+        enum class Format { Y4M, RGBA };
+
+        static Error parseFormat(const std::string& name, Format& format);
+
+        PipeRecorder(size_t max_queued=4);
+        ~PipeRecorder();
+
+        Error open(const std::string& path, Format format, unsigned int width, unsigned int height, unsigned int fps, bool blocking);
+        void close();
+
+        // Pixels are RGBA8 rows, bottom row first (as read from OpenGL)
+        bool push(const unsigned char* pixels);
+        void drop();
+
+        size_t getWritten() const;
+        size_t getDropped() const;
+
+    private:
+        void run();
+        bool writeFrame(const std::vector<unsigned char>& pixels);
+        bool writeY4M(const std::vector<unsigned char>& pixels);
+        bool writeRGBA(const std::vector<unsigned char>& pixels);
+
+        std::mutex mutex_;
+        std::condition_variable frame_ready_;
+        std::condition_variable frame_taken_;
+        std::deque<std::vector<unsigned char>> frames_;
+        std::vector<std::vector<unsigned char>> free_buffers_;
+        std::vector<unsigned char> yuv_;
+        size_t max_queued_;
+        bool running_ = false;
+        bool blocking_ = false;
+
+        std::atomic<size_t> written_;
+        std::atomic<size_t> dropped_;
+
+        FILE* out_ = nullptr;
+        bool close_out_ = false;
+        Format format_ = Format::Y4M;
+        unsigned int width_ = 0;
+        unsigned int height_ = 0;
+        std::thread thread_;
+};
+
+#endif
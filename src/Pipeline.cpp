@@ -0,0 +1,300 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+#include "yaml-cpp/yaml.h"
+
+Pipeline Pipeline::single(const std::filesystem::path& vert, const std::filesystem::path& frag, int repeat) {
+    Pass pass;
+    pass.name = "main";
+    pass.vert = vert;
+    pass.frag = frag;
+    pass.repeat = repeat;
+    pass.history = true;
+
+    Pipeline pipeline;
+    pipeline.passes_.push_back(pass);
+
+    return pipeline;
+}
+
+const std::vector<Pipeline::Pass>& Pipeline::getPasses() const {
+    return passes_;
+}
+
+size_t Pipeline::getOutput() const {
+    return output_;
+}
+
+bool Pipeline::parseIndexed(const std::string& name, const std::string& prefix, size_t& index) {
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+
+    const std::string digits = name.substr(prefix.size());
+    if (digits.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+
+    // Too many digits for any real input, so it's saturated to one that's out of range
+    std::from_chars_result parsed = std::from_chars(digits.data(), digits.data() + digits.size(), index);
+    if (parsed.ec != std::errc()) {
+        index = std::numeric_limits<size_t>::max();
+    }
+
+    return true;
+}
+
+Error Pipeline::load(const std::filesystem::path& path, const std::filesystem::path& vert, int repeat) {
+    YAML::Node config;
+
+    try {
+        config = YAML::LoadFile(path.string());
+    } catch (std::runtime_error& err) {
+        return err.what();
+    }
+
+    const std::filesystem::path dir = path.parent_path();
+    std::vector<std::vector<InputRef>> refs;
+    std::string output;
+
+    try {
+        if (!config["passes"].IsSequence() || config["passes"].size() == 0) {
+            return path.string() + " has no passes";
+        }
+
+        for (const auto& node : config["passes"]) {
+            Pass pass;
+            pass.name = node["name"].as<std::string>("");
+
+            bool identifier = !pass.name.empty() && !std::isdigit(static_cast<unsigned char>(pass.name[0]))
+                && std::all_of(pass.name.begin(), pass.name.end(), [](unsigned char c) { return std::isalnum(c) || c == '_'; });
+            if (!identifier) {
+                return "Pass name '" + pass.name + "' isn't usable as a GLSL name";
+            }
+
+            size_t index = 0;
+            if (parseIndexed(pass.name, "img", index) || parseIndexed(pass.name, "cap", index)) {
+                return "Pass name '" + pass.name + "' is taken by an input";
+            }
+
+            bool taken = std::any_of(passes_.begin(), passes_.end(), [&pass](const Pass& other) { return other.name == pass.name; });
+            if (taken) {
+                return "There's more than one pass named '" + pass.name + "'";
+            }
+
+            if (!node["frag"]) {
+                return "Pass '" + pass.name + "' has no frag";
+            }
+            pass.frag = dir / node["frag"].as<std::string>();
+            pass.vert = node["vert"] ? dir / node["vert"].as<std::string>() : vert;
+
+            pass.repeat = node["repeat"] ? node["repeat"].as<int>() : repeat;
+            if (pass.repeat < 1) {
+                return "Pass '" + pass.name + "' must repeat at least once";
+            }
+
+            if (node["scale"] && node["size"]) {
+                return "Pass '" + pass.name + "' has both a scale and a size, it can only have one";
+            }
+
+            if (node["scale"]) {
+                pass.scale = node["scale"].as<double>();
+                if (pass.scale <= 0 || pass.scale > 1) {
+                    return "Pass '" + pass.name + "' has scale " + node["scale"].as<std::string>() + ", it must be above 0 and at most 1";
+                }
+            }
+
+            if (node["size"]) {
+                try {
+                    pass.size.set(node["size"].as<std::string>());
+                } catch (std::logic_error& err) {
+                    return "Pass '" + pass.name + "' has size '" + node["size"].as<std::string>() + "': " + err.what();
+                }
+
+                if (pass.size.getWidth<int>() == 0 || pass.size.getHeight<int>() == 0) {
+                    return "Pass '" + pass.name + "' has an empty size";
+                }
+            }
+
+            std::vector<InputRef> pass_refs;
+            for (const auto& input : node["inputs"]) {
+                std::string name = input.as<std::string>();
+                InputRef ref;
+                size_t dot = name.find('.');
+                ref.name = name.substr(0, dot);
+                if (dot != std::string::npos) {
+                    if (name.substr(dot + 1) != "prev") {
+                        return "Pass '" + pass.name + "' has input '" + name + "', the only suffix is .prev";
+                    }
+                    ref.prev = true;
+                }
+
+                pass_refs.push_back(ref);
+            }
+
+            passes_.push_back(pass);
+            refs.push_back(pass_refs);
+        }
+
+        output = config["output"] ? config["output"].as<std::string>() : passes_.back().name;
+    } catch (YAML::Exception& err) {
+        return path.string() + ": " + err.what();
+    }
+
+    return schedule(refs, output);
+}
+
+Error Pipeline::schedule(const std::vector<std::vector<InputRef>>& refs, const std::string& output) {
+    std::map<std::string, size_t> by_name;
+    for (size_t i = 0; i < passes_.size(); i++) {
+        by_name[passes_[i].name] = i;
+    }
+
+    if (!by_name.count(output)) {
+        return "The output '" + output + "' isn't a pass";
+    }
+
+    // It's what gets shown, recorded and saved, all at the resolution asked for
+    Pass& output_pass = passes_[by_name.at(output)];
+    if (output_pass.scale != 1.0 || output_pass.size.getWidth<int>() != 0) {
+        return "The output '" + output + "' is always full size, draw it from a smaller pass instead";
+    }
+
+    // Resolved against declaration order for now, renumbered once sorted
+    for (size_t i = 0; i < passes_.size(); i++) {
+        Pass& pass = passes_[i];
+        for (const auto& ref : refs[i]) {
+            Input input;
+            if (parseIndexed(ref.name, "img", input.index)) {
+                input.kind = Input::Kind::Image;
+            } else if (parseIndexed(ref.name, "cap", input.index)) {
+                input.kind = Input::Kind::Capture;
+            } else if (by_name.count(ref.name)) {
+                input.index = by_name.at(ref.name);
+                input.kind = ref.prev ? Input::Kind::PassPrev : Input::Kind::Pass;
+            } else {
+                return "Pass '" + pass.name + "' reads '" + ref.name + "', which isn't a pass, imgN or capN";
+            }
+
+            bool is_pass = input.kind == Input::Kind::Pass || input.kind == Input::Kind::PassPrev;
+            if (ref.prev && !is_pass) {
+                return "Pass '" + pass.name + "' reads '" + ref.name + ".prev', only passes have a previous frame";
+            }
+
+            if (input.kind == Input::Kind::Pass && input.index == i) {
+                return "Pass '" + pass.name + "' reads its own output, use " + pass.name + ".prev for last frame's";
+            }
+
+            input.sampler = ref.prev ? ref.name + "Prev" : ref.name;
+            std::string title = ref.name;
+            title[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(title[0])));
+            input.resolution = "iResolution" + title;
+
+            pass.inputs.push_back(input);
+        }
+    }
+
+    // Whatever the output doesn't depend on, this frame or later, is never drawn
+    std::vector<bool> needed(passes_.size(), false);
+    std::vector<size_t> stack = {by_name.at(output)};
+    while (!stack.empty()) {
+        size_t i = stack.back();
+        stack.pop_back();
+        if (needed[i]) {
+            continue;
+        }
+
+        needed[i] = true;
+        for (const auto& input : passes_[i].inputs) {
+            if (input.kind == Input::Kind::Pass || input.kind == Input::Kind::PassPrev) {
+                stack.push_back(input.index);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < passes_.size(); i++) {
+        if (!needed[i]) {
+            std::cerr << "Warning: pass '" << passes_[i].name << "' doesn't lead to the output '" << output
+                << "', skipping it" << std::endl;
+        }
+    }
+
+    // Each pass goes as soon as what it reads this frame has been drawn, ties in the order given
+    std::vector<size_t> order;
+    std::vector<bool> placed(passes_.size(), false);
+    while (true) {
+        bool progress = false;
+        for (size_t i = 0; i < passes_.size(); i++) {
+            if (!needed[i] || placed[i]) {
+                continue;
+            }
+
+            bool ready = std::all_of(passes_[i].inputs.begin(), passes_[i].inputs.end(), [&placed](const Input& input) {
+                return input.kind != Input::Kind::Pass || placed[input.index];
+            });
+            if (ready) {
+                order.push_back(i);
+                placed[i] = true;
+                progress = true;
+                break;
+            }
+        }
+
+        if (!progress) {
+            break;
+        }
+    }
+
+    size_t needed_count = static_cast<size_t>(std::count(needed.begin(), needed.end(), true));
+    if (order.size() != needed_count) {
+        std::string stuck;
+        for (size_t i = 0; i < passes_.size(); i++) {
+            if (needed[i] && !placed[i]) {
+                stuck += (stuck.empty() ? "" : ", ") + passes_[i].name;
+            }
+        }
+
+        return "Passes " + stuck + " read each other in a loop, one of them needs to read .prev";
+    }
+
+    std::vector<size_t> position(passes_.size(), 0);
+    for (size_t pos = 0; pos < order.size(); pos++) {
+        position[order[pos]] = pos;
+    }
+
+    std::vector<Pass> sorted;
+    for (size_t i : order) {
+        Pass pass = passes_[i];
+        pass.history = pass.history || pass.repeat > 1;
+        pass.last_use = sorted.size();
+        for (auto& input : pass.inputs) {
+            if (input.kind == Input::Kind::Pass || input.kind == Input::Kind::PassPrev) {
+                input.index = position[input.index];
+            }
+        }
+        sorted.push_back(pass);
+    }
+
+    for (size_t pos = 0; pos < sorted.size(); pos++) {
+        for (const auto& input : sorted[pos].inputs) {
+            if (input.kind == Input::Kind::PassPrev) {
+                sorted[input.index].history = true;
+                sorted[input.index].keep_prev = sorted[input.index].repeat > 1;
+            } else if (input.kind == Input::Kind::Pass) {
+                sorted[input.index].last_use = std::max(sorted[input.index].last_use, pos);
+            }
+        }
+    }
+
+    passes_ = sorted;
+    output_ = position[by_name.at(output)];
+
+    return {};
+}
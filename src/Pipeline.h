@@ -0,0 +1,82 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Result.h"
+#include "Size.h"
+
+// A render graph: named passes, each a fragment shader drawn into its own
+// target, reading other passes' output from this frame or the last. Passes
+// are kept in an order where each comes after the passes it reads this
+// frame, and passes the output doesn't depend on are dropped.
+//
+// Described in YAML, with paths relative to the file:
+//
+//   passes:
+//     - name: bufA
+//       frag: bufA.glsl
+//       inputs: [bufA.prev, cap0]
+//     - name: image
+//       frag: image.glsl
+//       inputs: [bufA]
+//   output: image
+//
+// A pass may be drawn smaller than the output with scale (0.5 for half the
+// width and height) or a fixed size (640x360). The output is always full size.
+class Pipeline {
+    public:
+        struct Input {
+            // A pass's index in getPasses(), or for an image or capture its N
+            size_t index = 0;
+            enum class Kind { Pass, PassPrev, Image, Capture } kind = Kind::Pass;
+            // What the shader calls the sampler and its resolution
+            std::string sampler;
+            std::string resolution;
+        };
+
+        struct Pass {
+            std::string name;
+            std::filesystem::path vert;
+            std::filesystem::path frag;
+            int repeat = 1;
+            // Of the output resolution, unless it has a fixed size
+            double scale = 1.0;
+            // 0x0 when it follows the output resolution
+            Size size;
+            std::vector<Input> inputs;
+            // Its output from the previous frame is read, as .prev or by repeating
+            bool history = false;
+            // Read as .prev while it repeats, so last frame's output has to be kept
+            // out of the way of this frame's iterations
+            bool keep_prev = false;
+            // The last pass, by index, that reads this frame's output. Its own index if nothing does.
+            size_t last_use = 0;
+        };
+
+        // One pass drawing frag over its own last output, what illum always did
+        static Pipeline single(const std::filesystem::path& vert, const std::filesystem::path& frag, int repeat);
+
+        // vert and repeat are for passes that don't give their own
+        Error load(const std::filesystem::path& path, const std::filesystem::path& vert, int repeat);
+
+        // In drawing order
+        const std::vector<Pass>& getPasses() const;
+        size_t getOutput() const;
+
+    private:
+        struct InputRef {
+            std::string name;
+            bool prev = false;
+        };
+
+        Error schedule(const std::vector<std::vector<InputRef>>& refs, const std::string& output);
+        static bool parseIndexed(const std::string& name, const std::string& prefix, size_t& index);
+
+        std::vector<Pass> passes_;
+        size_t output_ = 0;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <cstring>
+#include <errno.h>
+
+Profiler::Phase Profiler::addPhase(const std::string& name) {
+    phases_.push_back(PhaseData{});
+    phases_.back().name = name;
+
+    return phases_.size() - 1;
+}
+
+void Profiler::setEnabled(bool enabled) {
+    enabled_ = enabled;
+}
+
+bool Profiler::isEnabled() const {
+    return enabled_;
+}
+
+void Profiler::start(Phase phase) {
+    if (!enabled_) {
+        return;
+    }
+
+    phases_[phase].started = Clock::now();
+}
+
+void Profiler::stop(Phase phase) {
+    if (!enabled_) {
+        return;
+    }
+
+    PhaseData& data = phases_[phase];
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - data.started;
+    data.cpu_ms.push_back(elapsed.count());
+}
+
+void Profiler::startGPU(Phase phase) {
+    if (!enabled_) {
+        return;
+    }
+
+    GLuint query;
+    if (free_queries_.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = free_queries_.back();
+        free_queries_.pop_back();
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    pending_queries_.push_back(PendingQuery{query, phase});
+}
+
+void Profiler::stopGPU() {
+    if (!enabled_) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void Profiler::collect(bool wait) {
+    // Queries finish in submission order, so stop at the first one still in flight
+    while (!pending_queries_.empty()) {
+        PendingQuery pending = pending_queries_.front();
+
+        if (!wait) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                break;
+            }
+        }
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &ns);
+        phases_[pending.phase].gpu_ms.push_back(static_cast<double>(ns) / 1e6);
+
+        free_queries_.push_back(pending.query);
+        pending_queries_.pop_front();
+    }
+}
+
+void Profiler::writeStats(std::ostream& out, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest-rank percentile
+    auto percentile = [&samples](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+        return samples[std::max<size_t>(rank, 1) - 1];
+    };
+
+    double total = 0;
+    for (double s : samples) {
+        total += s;
+    }
+
+    out << "{"
+        << "\"count\": " << samples.size() << ", "
+        << "\"mean\": " << total / static_cast<double>(samples.size()) << ", "
+        << "\"p50\": " << percentile(50) << ", "
+        << "\"p95\": " << percentile(95) << ", "
+        << "\"p99\": " << percentile(99) << ", "
+        << "\"max\": " << samples.back()
+        << "}";
+}
+
+Error Profiler::write(const std::filesystem::path& path) {
+    collect(true);
+
+    std::ofstream out(path);
+    if (out.fail()) {
+        return "Error opening " + path.string() + " - " + std::strerror(errno);
+    }
+
+    // Both sections share the same layout: phase name -> stats in milliseconds
+    auto write_section = [this, &out](const std::string& key, std::vector<double> PhaseData::* samples) {
+        out << "  \"" << key << "\": {";
+
+        bool first = true;
+        for (const auto& phase : phases_) {
+            if ((phase.*samples).empty()) {
+                continue;
+            }
+
+            out << (first ? "\n" : ",\n") << "    \"" << phase.name << "\": ";
+            writeStats(out, phase.*samples);
+            first = false;
+        }
+
+        out << (first ? "}" : "\n  }");
+    };
+
+    out << "{\n"
+        << "  \"unit\": \"ms\",\n";
+    write_section("cpu", &PhaseData::cpu_ms);
+    out << ",\n";
+    write_section("gpu", &PhaseData::gpu_ms);
+    out << "\n}\n";
+
+    if (out.fail()) {
+        return "Error writing " + path.string();
+    }
+
+    return {};
+}
@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Result.h"
+
+// Collects CPU (steady clock) and GPU (GL_TIME_ELAPSED) timings for named phases
+// of a frame. Does nothing until enabled, so the timing calls can stay in place.
+class Profiler {
+    public:
+        using Phase = size_t;
+
+        Phase addPhase(const std::string& name);
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+
+        void start(Phase phase);
+        void stop(Phase phase);
+
+        // GPU timer queries can't nest, only one may be active at a time
+        void startGPU(Phase phase);
+        void stopGPU();
+
+        // Harvest finished GPU queries without stalling, or all of them if wait is set
+        void collect(bool wait=false);
+
+        Error write(const std::filesystem::path& path);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct PhaseData {
+            std::string name;
+            Clock::time_point started;
+            std::vector<double> cpu_ms;
+            std::vector<double> gpu_ms;
+        };
+
+        struct PendingQuery {
+            GLuint query;
+            Phase phase;
+        };
+
+        static void writeStats(std::ostream& out, std::vector<double> samples);
+
+        bool enabled_ = false;
+        std::vector<PhaseData> phases_;
+        std::vector<GLuint> free_queries_;
+        std::deque<PendingQuery> pending_queries_;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "ProgramCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "AtomicWrite.h"
+
+#define CACHE_MAGIC "ILLUMPRG"
+#define CACHE_VERSION 1
+
+// Followed by size bytes of program binary
+struct ProgramCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t size;
+};
+
+ProgramCache::ProgramCache(const std::filesystem::path& dir) : dir_(dir) {}
+
+uint64_t ProgramCache::key(const std::map<GLenum, std::string>& sources) {
+    // FNV-1a, which unlike std::hash is the same from one build to the next
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name : names) {
+        const GLubyte* value = glGetString(name);
+        std::string driver = value ? reinterpret_cast<const char*>(value) : "";
+        // Sizes go in too, so moving text from one string to the next changes the key
+        uint64_t size = driver.size();
+        mix(&size, sizeof(size));
+        mix(driver.data(), driver.size());
+    }
+
+    for (const auto& [type, source] : sources) {
+        uint64_t size = source.size();
+        mix(&type, sizeof(type));
+        mix(&size, sizeof(size));
+        mix(source.data(), source.size());
+    }
+
+    return hash;
+}
+
+std::filesystem::path ProgramCache::entryPath(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << key << ".program";
+    return dir_ / name.str();
+}
+
+bool ProgramCache::load(uint64_t key, GLuint program) const {
+    std::ifstream in(entryPath(key), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    Header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    bool current = in
+        && std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == CACHE_VERSION
+        && header.key == key;
+    if (!current) {
+        return false;
+    }
+
+    // Trusting the size before checking it against the file would let a corrupt
+    // entry ask for any amount of memory, rather than just being a miss
+    std::streamoff start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streamoff remaining = in.tellg() - start;
+    in.seekg(start);
+    if (!in || remaining < 0 || header.size != static_cast<uint64_t>(remaining)) {
+        return false;
+    }
+
+    std::vector<char> binary(static_cast<size_t>(header.size));
+    in.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!in) {
+        return false;
+    }
+
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+Error ProgramCache::store(uint64_t key, GLuint program) const {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    // Drivers without any binary formats hand back nothing, which isn't worth complaining about
+    if (length <= 0) {
+        return {};
+    }
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = GL_NONE;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) {
+        return {};
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.format = format;
+    header.key = key;
+    header.size = static_cast<uint64_t>(written);
+
+    return writeAtomically(entryPath(key), [&header, &binary, written](std::ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+    });
+}
+
+#undef CACHE_MAGIC
+#undef CACHE_VERSION
@@ -0,0 +1,40 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "Result.h"
+
+// Linked programs kept on disk as driver binaries, so unchanged shaders load
+// without compiling. Entries are keyed by a hash of every stage's source
+// (includes expanded) and the driver's vendor, renderer and version, so
+// editing a shader or updating the driver just misses. A driver is free to
+// reject a binary anyway; load() reports that as a miss and the caller
+// compiles as usual.
+class ProgramCache {
+    public:
+        ProgramCache(const std::filesystem::path& dir);
+
+        // For the sources by the driver that's current on this thread
+        static uint64_t key(const std::map<GLenum, std::string>& sources);
+
+        // Links program from the cached binary. False if there isn't one or the driver won't take it.
+        bool load(uint64_t key, GLuint program) const;
+        // program should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+        // Safe to call from several threads, each with its own context.
+        Error store(uint64_t key, GLuint program) const;
+
+    private:
+        struct Header;
+
+        std::filesystem::path entryPath(uint64_t key) const;
+
+        std::filesystem::path dir_;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "Readback.h"
+
+Readback::Readback(size_t slots) : slots_(slots) {}
+
+Readback::~Readback() {
+    for (auto& slot : slots_) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+
+        if (slot.pbo != GL_FALSE) {
+            glDeleteBuffers(1, &slot.pbo);
+        }
+    }
+}
+
+bool Readback::request(GLuint fbo, GLenum attachment, GLsizei width, GLsizei height, Callback done) {
+    if (in_flight_.size() == slots_.size()) {
+        return false;
+    }
+
+    // Slots are handed out and retired in order, so the next free one follows the newest
+    size_t idx = in_flight_.empty() ? 0 : (in_flight_.back() + 1) % slots_.size();
+    Slot& slot = slots_[idx];
+
+    if (slot.pbo == GL_FALSE) {
+        glGenBuffers(1, &slot.pbo);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+    if (size != slot.size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot.size = size;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(attachment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.done = std::move(done);
+    in_flight_.push_back(idx);
+
+    return true;
+}
+
+bool Readback::finish(Slot& slot, GLuint64 timeout) {
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // On GL_WAIT_FAILED the read is abandoned rather than retried forever
+    if (status != GL_WAIT_FAILED) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+        if (pixels) {
+            slot.done(static_cast<const unsigned char*>(pixels));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    slot.done = nullptr;
+
+    return true;
+}
+
+void Readback::poll() {
+    while (!in_flight_.empty() && finish(slots_[in_flight_.front()], 0)) {
+        in_flight_.pop_front();
+    }
+}
+
+void Readback::flush() {
+    while (!in_flight_.empty()) {
+        // glClientWaitSync has no infinite timeout, so wait a second at a time
+        if (finish(slots_[in_flight_.front()], 1000000000)) {
+            in_flight_.pop_front();
+        }
+    }
+}
+
+size_t Readback::getInFlight() const {
+    return in_flight_.size();
+}
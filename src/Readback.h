@@ -0,0 +1,41 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Asynchronous framebuffer reads through a ring of pixel pack buffers. A request
+// only queues the copy on the GPU; once its fence has signaled (usually a frame
+// or two later) poll() maps the buffer and hands the pixels to the request's
+// callback. Pixels are tightly packed RGBA8, bottom row first.
+class Readback {
+    public:
+        using Callback = std::function<void(const unsigned char* pixels)>;
+
+        Readback(size_t slots=3);
+        ~Readback();
+
+        // Returns false, without reading, when every buffer is still in flight
+        bool request(GLuint fbo, GLenum attachment, GLsizei width, GLsizei height, Callback done);
+        void poll();
+        void flush();
+        size_t getInFlight() const;
+
+    private:
+        struct Slot {
+            GLuint pbo = GL_FALSE;
+            GLsync fence = nullptr;
+            GLsizeiptr size = 0;
+            Callback done;
+        };
+
+        bool finish(Slot& slot, GLuint64 timeout);
+
+        std::vector<Slot> slots_;
+        std::deque<size_t> in_flight_;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+
+RenderTargetPool::~RenderTargetPool() {
+    for (const auto& target : targets_) {
+        glDeleteTextures(1, &target.tex);
+    }
+}
+
+GLuint RenderTargetPool::acquire(GLsizei width, GLsizei height) {
+    for (auto& target : targets_) {
+        if (!target.in_use && target.width == width && target.height == height) {
+            target.in_use = true;
+            return target.tex;
+        }
+    }
+
+    Target target;
+    target.width = width;
+    target.height = height;
+    target.in_use = true;
+
+    // Called in the middle of binding a pass's inputs, so whatever is bound to the
+    // active unit has to be there again afterwards
+    GLint bound = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+
+    glGenTextures(1, &target.tex);
+    glBindTexture(GL_TEXTURE_2D, target.tex);
+
+    // Give an empty image to OpenGL ( the last "0" )
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound));
+
+    targets_.push_back(target);
+
+    return target.tex;
+}
+
+void RenderTargetPool::release(GLuint tex) {
+    for (auto& target : targets_) {
+        if (target.tex == tex) {
+            target.in_use = false;
+            return;
+        }
+    }
+}
+
+void RenderTargetPool::trim() {
+    for (const auto& target : targets_) {
+        if (!target.in_use) {
+            glDeleteTextures(1, &target.tex);
+        }
+    }
+
+    targets_.erase(
+        std::remove_if(targets_.begin(), targets_.end(), [](const Target& target) { return !target.in_use; }),
+        targets_.end());
+}
+
+size_t RenderTargetPool::getAllocated() const {
+    return targets_.size();
+}
+
+size_t RenderTargetPool::getBytes() const {
+    size_t bytes = 0;
+    for (const auto& target : targets_) {
+        bytes += static_cast<size_t>(target.width) * static_cast<size_t>(target.height) * 4;
+    }
+
+    return bytes;
+}
@@ -0,0 +1,36 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Textures for passes to draw into. A target handed back with release() goes
+// to the next acquire() of the same size instead of a new allocation, so a
+// pipeline only ever holds as many as it has alive at once.
+class RenderTargetPool {
+    public:
+        ~RenderTargetPool();
+
+        // Leaves every texture binding as it was, even when it has to allocate
+        GLuint acquire(GLsizei width, GLsizei height);
+        void release(GLuint tex);
+        // Frees every target not currently acquired
+        void trim();
+
+        size_t getAllocated() const;
+        size_t getBytes() const;
+
+    private:
+        struct Target {
+            GLuint tex = GL_FALSE;
+            GLsizei width = 0;
+            GLsizei height = 0;
+            bool in_use = false;
+        };
+
+        std::vector<Target> targets_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "ResolutionGovernor.h"
+
+#include <iterator>
+
+// Frames averaged before deciding, enough to ride out a single slow one
+#define WINDOW_FRAMES 12
+// Stepping up is only worth it when the bigger step is predicted to fit with
+// this much to spare, otherwise it would just step back down
+#define HEADROOM 0.8
+
+// Render scales to step between, each drawing a quarter or so fewer pixels than the last
+static const double scale_steps[] = {1.0, 0.9, 0.8, 0.7, 0.6, 0.5, 0.42, 0.35, 0.3, 0.25};
+
+ResolutionGovernor::ResolutionGovernor(double target_ms) : target_ms_(target_ms) {}
+
+ResolutionGovernor::~ResolutionGovernor() {
+    for (const auto& frame : pending_) {
+        glDeleteQueries(1, &frame.begin);
+        glDeleteQueries(1, &frame.end);
+    }
+
+    if (!free_queries_.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(free_queries_.size()), free_queries_.data());
+    }
+}
+
+GLuint ResolutionGovernor::takeQuery() {
+    GLuint query;
+    if (free_queries_.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = free_queries_.back();
+        free_queries_.pop_back();
+    }
+
+    return query;
+}
+
+void ResolutionGovernor::beginFrame() {
+    current_.begin = takeQuery();
+    current_.step = step_;
+    glQueryCounter(current_.begin, GL_TIMESTAMP);
+}
+
+void ResolutionGovernor::endFrame() {
+    current_.end = takeQuery();
+    glQueryCounter(current_.end, GL_TIMESTAMP);
+    pending_.push_back(current_);
+}
+
+bool ResolutionGovernor::update() {
+    // Queries finish in submission order, so stop at the first frame still in flight
+    while (!pending_.empty()) {
+        PendingFrame frame = pending_.front();
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+
+        GLuint64 begin_ns = 0;
+        GLuint64 end_ns = 0;
+        glGetQueryObjectui64v(frame.begin, GL_QUERY_RESULT, &begin_ns);
+        glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end_ns);
+
+        // Frames drawn before the last change say nothing about the current scale
+        if (frame.step == step_) {
+            samples_.push_back(static_cast<double>(end_ns - begin_ns) / 1e6);
+        }
+
+        free_queries_.push_back(frame.begin);
+        free_queries_.push_back(frame.end);
+        pending_.pop_front();
+    }
+
+    changed_ = false;
+    if (samples_.size() >= WINDOW_FRAMES) {
+        decide();
+        samples_.clear();
+    }
+
+    return changed_;
+}
+
+void ResolutionGovernor::decide() {
+    double total = 0;
+    for (double ms : samples_) {
+        total += ms;
+    }
+    double mean = total / static_cast<double>(samples_.size());
+
+    if (mean > target_ms_) {
+        if (step_ + 1 < std::size(scale_steps)) {
+            step_++;
+            changed_ = true;
+        }
+        return;
+    }
+
+    // Most of the cost follows the pixel count, so predict the bigger step by area
+    if (step_ > 0) {
+        double ratio = scale_steps[step_ - 1] / scale_steps[step_];
+        if (mean * ratio * ratio < target_ms_ * HEADROOM) {
+            step_--;
+            changed_ = true;
+        }
+    }
+}
+
+double ResolutionGovernor::getScale() const {
+    return scale_steps[step_];
+}
+
+double ResolutionGovernor::getTargetMs() const {
+    return target_ms_;
+}
+
+#undef WINDOW_FRAMES
+#undef HEADROOM
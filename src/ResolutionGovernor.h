@@ -0,0 +1,48 @@
+#ifndef RESOLUTION_GOVERNOR_H
+#define RESOLUTION_GOVERNOR_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Holds the GPU's frame time near a target by stepping the render scale down
+// when frames run long and back up when there's room. Frames are timed with
+// timestamp queries, which unlike GL_TIME_ELAPSED can sit around the
+// profiler's, and results are only read once the GPU has them.
+class ResolutionGovernor {
+    public:
+        explicit ResolutionGovernor(double target_ms);
+        ~ResolutionGovernor();
+
+        void beginFrame();
+        void endFrame();
+
+        // Harvests finished frames, true when the scale has just changed
+        bool update();
+
+        double getScale() const;
+        double getTargetMs() const;
+
+    private:
+        struct PendingFrame {
+            GLuint begin;
+            GLuint end;
+            // The step it was drawn at
+            size_t step;
+        };
+
+        GLuint takeQuery();
+        void decide();
+
+        double target_ms_;
+        size_t step_ = 0;
+        bool changed_ = false;
+        std::vector<double> samples_;
+        std::vector<GLuint> free_queries_;
+        std::deque<PendingFrame> pending_;
+        PendingFrame current_ = {};
+};
+
+#endif
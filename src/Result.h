@@ -2,6 +2,8 @@
 #define RESULT_H
 
 #include <optional>
+#include <string>
+#include <utility>
 
 template<typename T>
 using Result = std::pair<std::optional<T>, std::optional<std::string>>;
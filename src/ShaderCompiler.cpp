@@ -0,0 +1,184 @@
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+
+std::unique_ptr<ShaderCompiler> ShaderCompiler::create(std::unique_ptr<SharedContext> context) {
+    if (!context) {
+        return nullptr;
+    }
+
+    // Find out up front whether the context works there, so callers know which way to build
+    std::unique_ptr<ShaderCompiler> compiler(new ShaderCompiler(std::move(context)));
+    std::promise<bool> current;
+    std::future<bool> is_current = current.get_future();
+    compiler->thread_ = std::thread([ptr = compiler.get(), current = std::move(current)]() mutable {
+        ptr->run(current);
+    });
+
+    if (!is_current.get()) {
+        return nullptr;
+    }
+
+    return compiler;
+}
+
+ShaderCompiler::ShaderCompiler(std::unique_ptr<SharedContext> context) : context_(std::move(context)) {}
+
+ShaderCompiler::~ShaderCompiler() {
+    {
+        std::lock_guard guard(mutex_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    for (auto& kv : built_) {
+        discard(kv.second);
+    }
+}
+
+void ShaderCompiler::submit(const void* owner, Job job) {
+    {
+        std::lock_guard guard(mutex_);
+        auto queued = std::find_if(jobs_.begin(), jobs_.end(), [owner](const auto& entry) { return entry.first == owner; });
+        if (queued != jobs_.end()) {
+            queued->second = std::move(job);
+        } else {
+            jobs_.emplace_back(owner, std::move(job));
+        }
+    }
+    cond_.notify_all();
+}
+
+std::optional<ShaderCompiler::Build> ShaderCompiler::collect(const void* owner) {
+    std::lock_guard guard(mutex_);
+    auto it = built_.find(owner);
+    if (it == built_.end()) {
+        return {};
+    }
+
+    Build& build = it->second;
+    if (build.fence != NULL) {
+        if (glClientWaitSync(build.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return {};
+        }
+
+        glDeleteSync(build.fence);
+        build.fence = NULL;
+    }
+
+    Build done = std::move(build);
+    built_.erase(it);
+
+    return done;
+}
+
+void ShaderCompiler::forget(const void* owner) {
+    std::lock_guard guard(mutex_);
+    jobs_.erase(
+        std::remove_if(jobs_.begin(), jobs_.end(), [owner](const auto& entry) { return entry.first == owner; }),
+        jobs_.end());
+
+    auto it = built_.find(owner);
+    if (it != built_.end()) {
+        discard(it->second);
+        built_.erase(it);
+    }
+
+    if (building_ == owner) {
+        forget_building_ = true;
+    }
+}
+
+void ShaderCompiler::discard(Build& build) {
+    if (build.fence != NULL) {
+        glDeleteSync(build.fence);
+        build.fence = NULL;
+    }
+
+    if (build.program != GL_FALSE) {
+        glDeleteProgram(build.program);
+        build.program = GL_FALSE;
+    }
+}
+
+void ShaderCompiler::run(std::promise<bool>& current) {
+    if (!context_->makeCurrent()) {
+        current.set_value(false);
+        return;
+    }
+    current.set_value(true);
+
+    // Let the driver spread compiling across its own threads
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+
+    // Framebuffers and vertex arrays aren't shared, so warming up needs its own
+    GLuint warm_tex = GL_FALSE;
+    GLuint warm_fbo = GL_FALSE;
+    GLuint warm_vao = GL_FALSE;
+    glGenTextures(1, &warm_tex);
+    glBindTexture(GL_TEXTURE_2D, warm_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &warm_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, warm_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, warm_tex, 0);
+    glGenVertexArrays(1, &warm_vao);
+    glBindVertexArray(warm_vao);
+    glViewport(0, 0, 1, 1);
+
+    std::unique_lock lock(mutex_);
+    while (true) {
+        cond_.wait(lock, [this]{ return !jobs_.empty() || !running_; });
+        if (!running_) {
+            break;
+        }
+
+        auto [owner, job] = std::move(jobs_.front());
+        jobs_.pop_front();
+        building_ = owner;
+        forget_building_ = false;
+        lock.unlock();
+
+        Build build = job();
+        if (build.program != GL_FALSE) {
+            // Drivers put off some of the work until a program is first drawn
+            // with, so that happens here rather than in the middle of a frame
+            glUseProgram(build.program);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glUseProgram(0);
+        }
+
+        // Flushed, or the render thread could wait forever on a fence we never submitted
+        build.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        lock.lock();
+        building_ = nullptr;
+        if (forget_building_) {
+            discard(build);
+            continue;
+        }
+
+        auto previous = built_.find(owner);
+        if (previous != built_.end()) {
+            discard(previous->second);
+        }
+        built_[owner] = std::move(build);
+    }
+    lock.unlock();
+
+    glDeleteVertexArrays(1, &warm_vao);
+    glDeleteFramebuffers(1, &warm_fbo);
+    glDeleteTextures(1, &warm_tex);
+    glFinish();
+
+    context_->release();
+}
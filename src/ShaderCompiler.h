@@ -0,0 +1,71 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Result.h"
+#include "SharedContext.h"
+
+// Builds shader programs on a thread of its own, with a context shared with
+// the render thread's, so a slow compile never holds up a frame. Where the
+// driver has KHR_parallel_shader_compile it also spreads the work across the
+// driver's threads. One compiler serves any number of programs.
+class ShaderCompiler {
+    public:
+        // What a build hands back. The program is usable on the render thread once fence has signaled.
+        struct Build {
+            GLuint program = GL_FALSE;
+            // Each stage's file and the files it includes
+            std::map<GLenum, std::vector<std::filesystem::path>> sources;
+            Error err;
+            GLsync fence = NULL;
+        };
+
+        using Job = std::function<Build()>;
+
+        // nullptr if the context can't be used from another thread
+        static std::unique_ptr<ShaderCompiler> create(std::unique_ptr<SharedContext> context);
+        ~ShaderCompiler();
+
+        // Runs job on the compile thread, then draws once with the program it built
+        // so the driver finishes with it there. A newer job from the same owner
+        // replaces one that hasn't started, and a newer result replaces an older one.
+        void submit(const void* owner, Job job);
+        // The owner's newest build, once the GPU has caught up with it. Never blocks.
+        std::optional<Build> collect(const void* owner);
+        // Drops everything queued or finished for owner
+        void forget(const void* owner);
+
+        // Deletes what a build holds, from either thread
+        static void discard(Build& build);
+
+    private:
+        ShaderCompiler(std::unique_ptr<SharedContext> context);
+
+        void run(std::promise<bool>& current);
+
+        std::unique_ptr<SharedContext> context_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::deque<std::pair<const void*, Job>> jobs_;
+        std::map<const void*, Build> built_;
+        // Whose job is running, so forget() can drop its result when it lands
+        const void* building_ = nullptr;
+        bool forget_building_ = false;
+        bool running_ = true;
+        std::thread thread_;
+};
+
+#endif
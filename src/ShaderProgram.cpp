@@ -5,20 +5,95 @@
 #include <cstring>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 
 #include <GLFW/glfw3.h>
 
+#define MAX_INCLUDE_DEPTH 16
+
 ShaderProgram::ShaderProgram() : program_(glCreateProgram()) {}
 
 ShaderProgram::~ShaderProgram() {
-    for (const auto& kv : shaders_) {
-        glDeleteShader(kv.second.handle);
+    if (compiler_) {
+        compiler_->forget(this);
     }
 
     glDeleteProgram(program_);
 }
 
-Error ShaderProgram::loadShader(GLenum type, const std::string& path) {
+void ShaderProgram::addInclude(const std::string& name, const std::string& source) {
+    includes_[name] = source;
+}
+
+void ShaderProgram::bindUniformBlock(const std::string& name, GLuint binding) {
+    block_bindings_[name] = binding;
+}
+
+void ShaderProgram::setCache(std::shared_ptr<ProgramCache> cache) {
+    cache_ = cache;
+}
+
+void ShaderProgram::setCompiler(ShaderCompiler* compiler) {
+    compiler_ = compiler;
+}
+
+// Expands lines of the form #include "name", preferring sources registered with
+// addInclude and otherwise reading the file relative to the including shader.
+Error ShaderProgram::resolveIncludes(const std::map<std::string, std::string>& includes, const std::string& source, const std::filesystem::path& dir, std::string& out, int depth, std::vector<std::filesystem::path>& files) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        return "Includes nested too deeply (recursive include?)";
+    }
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            out += line + "\n";
+            continue;
+        }
+
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            return "Malformed include: " + line;
+        }
+
+        const std::string name = line.substr(open + 1, close - open - 1);
+        if (includes.count(name)) {
+            Error err = resolveIncludes(includes, includes.at(name), dir, out, depth + 1, files);
+            if (err) {
+                return err;
+            }
+
+            continue;
+        }
+
+        const std::filesystem::path include_path = dir / name;
+        files.push_back(include_path);
+        std::ifstream ifs(include_path);
+        if (ifs.fail()) {
+            std::ostringstream err;
+            err << "Error loading include " << include_path << " - " <<  std::strerror(errno);
+            return err.str();
+        }
+
+        std::stringstream stream;
+        stream << ifs.rdbuf();
+        Error err = resolveIncludes(includes, stream.str(), include_path.parent_path(), out, depth + 1, files);
+        if (err) {
+            return err;
+        }
+    }
+
+    return {};
+}
+
+// Reads a stage's file with its includes expanded. files gets everything that
+// went into it, even when something is missing, so fixing it can be noticed.
+Error ShaderProgram::readStage(const std::filesystem::path& path, const std::map<std::string, std::string>& includes, std::string& source, std::vector<std::filesystem::path>& files) {
+    files = {path};
+
     std::ifstream ifs(path);
     if (ifs.fail()) {
         std::ostringstream err;
@@ -28,162 +103,258 @@ Error ShaderProgram::loadShader(GLenum type, const std::string& path) {
 
     std::stringstream stream;
     stream << ifs.rdbuf();
-    const std::string source = stream.str();
 
+    return resolveIncludes(includes, stream.str(), path.parent_path(), source, 0, files);
+}
+
+ShaderProgram::ShaderHandle ShaderProgram::compile(GLenum type, const std::string& source) {
     const char* c_source = source.c_str();
     GLuint shader = glCreateShader(type);
 
     glShaderSource(shader, 1, &c_source, NULL);
     glCompileShader(shader);
 
+    return shader;
+}
+
+Error ShaderProgram::checkCompile(ShaderHandle shader, const std::filesystem::path& path) {
     int status = 0;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        GLint log_length = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
-        std::vector<char> v(static_cast<size_t>(log_length));
-        glGetShaderInfoLog(shader, log_length, NULL, v.data());
-
-        std::ostringstream err;
-        err << "Error compiling " << path <<  ":\n" << std::string(begin(v), end(v));
-        return err.str();
+    if (status) {
+        return {};
     }
 
-    std::error_code err;
-    std::filesystem::file_time_type last_modified = std::filesystem::last_write_time(path, err);
-    if (err) {
-        return err.message();
-    }
+    GLint log_length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+    std::vector<char> v(static_cast<size_t>(log_length) + 1);
+    glGetShaderInfoLog(shader, log_length, NULL, v.data());
 
-    if (shaders_.count(type)) {
-        glDeleteShader(shaders_[type].handle);
-    }
+    std::ostringstream err;
+    err << "Error compiling " << path <<  ":\n" << std::string(v.data());
+    return err.str();
+}
 
-    shaders_[type] = Shader{};
-    Shader& obj = shaders_.at(type);
-    obj.handle = shader;
-    obj.last_modified = last_modified;
-    obj.path = path;
-    obj.type = type;
+Error ShaderProgram::checkLink(ProgramHandle program) {
+    int status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status) {
+        return {};
+    }
 
-    should_switch_ = true;
+    GLint log_length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+    std::vector<char> v(static_cast<size_t>(log_length) + 1);
+    glGetProgramInfoLog(program, log_length, NULL, v.data());
 
-    return {};
+    std::ostringstream err;
+    err << "Error linking shader program: \n" << std::string(v.data());
+    return err.str();
 }
 
-void ShaderProgram::markUniformInUse(const std::string& name) {
-    std::optional<GLint> loc = getUniformLoc(name);
-    if (loc) {
-        set_uniforms_.push_back(loc.value());
+void ShaderProgram::applyBlockBindings(ProgramHandle program, const std::map<std::string, GLuint>& bindings) {
+    for (const auto& kv : bindings) {
+        GLuint index = glGetUniformBlockIndex(program, kv.first.c_str());
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, index, kv.second);
+        }
     }
 }
 
-void ShaderProgram::setUniform(const std::string& name, std::function<void(GLint&)> f) {
-    if (!uniforms_.count(name)) {
-        return;
+Error ShaderProgram::loadShader(GLenum type, const std::string& path) {
+    // Watch everything this stage is made of, even if it can't be read, so fixing it is noticed
+    std::string source;
+    std::vector<std::filesystem::path> files;
+    Error err = readStage(path, includes_, source, files);
+    sources_[type] = files;
+    watchSources();
+
+    return err;
+}
+
+Error ShaderProgram::link() {
+    Build built = build(makeRequest());
+    adopt(built);
+
+    return last_err_;
+}
+
+void ShaderProgram::watchSources() {
+    for (const auto& kv : sources_) {
+        for (const auto& file : kv.second) {
+            watcher_.watch(file);
+        }
     }
+}
 
-    GLint id = uniforms_.at(name);
-    f(id);
+bool ShaderProgram::isDirty(const Sources::value_type& stage, const std::vector<std::filesystem::path>& changed) {
+    return std::any_of(stage.second.begin(), stage.second.end(), [&changed](const std::filesystem::path& file) {
+        return std::find(changed.begin(), changed.end(), std::filesystem::absolute(file).lexically_normal()) != changed.end();
+    });
+}
 
-    set_uniforms_.push_back(id);
+UniformRegistry& ShaderProgram::getUniforms() {
+    return uniforms_;
 }
 
 std::vector<std::string> ShaderProgram::getUnsetUniforms() {
-    std::vector<std::string> unused;
-    for (const auto& kv : uniforms_) {
-        std::string name = kv.first;
-        GLint id = kv.second;
+    return uniforms_.getUnset();
+}
 
-        if (set_uniforms_.end() == std::find(set_uniforms_.begin(), set_uniforms_.end(), id)) {
-            unused.push_back(name);
-        }
+ShaderProgram::BuildRequest ShaderProgram::makeRequest() const {
+    BuildRequest request;
+    for (const auto& kv : sources_) {
+        request.stages[kv.first] = kv.second.front();
     }
+    request.includes = includes_;
+    request.block_bindings = block_bindings_;
+    request.cache = cache_;
 
-    return unused;
+    return request;
 }
 
-Error ShaderProgram::update() {
-    for (auto const kv : shaders_) {
-        std::string path = kv.second.path;
-        std::error_code errc;
-        std::filesystem::file_time_type last_modified = std::filesystem::last_write_time(path, errc);
-        if (errc) {
+void ShaderProgram::adopt(Build& built) {
+    sources_ = built.sources;
+    watchSources();
+
+    last_err_ = built.err;
+    if (last_err_) {
+        return;
+    }
+
+    glDeleteProgram(program_);
+    program_ = built.program;
+    uniforms_.link(program_);
+}
+
+// Builds every stage from scratch, rather than keeping shader objects around
+// between builds: it's usually off the render thread, and a stage can't go stale.
+ShaderProgram::Build ShaderProgram::build(const BuildRequest& request) {
+    Build built;
+
+    // Every stage is read and compiled even once one has failed, so stages
+    // saved together are all reported together and none is left stale
+    std::string errors;
+    auto fail = [&errors](const std::string& err) {
+        errors += (errors.empty() ? "" : "\n") + err;
+    };
+
+    std::map<GLenum, std::string> sources;
+    for (const auto& [type, path] : request.stages) {
+        std::vector<std::filesystem::path> files;
+        Error err = readStage(path, request.includes, sources[type], files);
+        built.sources[type] = files;
+        if (err) {
             std::ostringstream s;
-            s << "Error accessing " << path << " " << errc.message();
-            return s.str();
+            s << "Error loading " << path << ":\n" << err.value();
+            fail(s.str());
         }
+    }
 
-        if (last_modified > kv.second.last_modified) {
-            Error err = loadShader(kv.first, path);
-            if (err.has_value()) {
-                std::ostringstream s;
-                s << "Error loading " << path << ":\n" << err.value();
-                return s.str();
-            }
-        }
+    if (!errors.empty()) {
+        built.err = errors;
+        return built;
     }
 
-    if (should_switch_) {
-        ProgramHandle next_prog = glCreateProgram();
-        for (const auto& kv : shaders_) {
-            glAttachShader(next_prog, kv.second.handle);
+    uint64_t key = 0;
+    if (request.cache) {
+        key = ProgramCache::key(sources);
+        built.program = glCreateProgram();
+        if (request.cache->load(key, built.program)) {
+            applyBlockBindings(built.program, request.block_bindings);
+            return built;
         }
 
-        glLinkProgram(next_prog);
+        // Missing or rejected, either way it's compiled as if there were no cache
+        glDeleteProgram(built.program);
+        built.program = GL_FALSE;
+    }
 
-        int status = 0;
-        glGetProgramiv(next_prog, GL_LINK_STATUS, &status);
-        if (!status) {
-            GLint log_length = 0;
-            glGetProgramiv(next_prog, GL_INFO_LOG_LENGTH, &log_length);
-            std::vector<char> v(static_cast<size_t>(log_length));
-            glGetProgramInfoLog(next_prog, log_length, NULL, v.data());
-            std::ostringstream err;
-            err << "Error linking shader program: \n" << std::string(begin(v), end(v));
-            return err.str();
-        }
+    std::vector<std::pair<ShaderHandle, std::filesystem::path>> shaders;
+    for (const auto& [type, path] : request.stages) {
+        shaders.emplace_back(compile(type, sources[type]), path);
+    }
 
-        GLint uni_name_len = 0;
-        glGetProgramiv(next_prog, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uni_name_len);
+    // With parallel compilation every stage is compiling by now, so
+    // they're waited on together rather than one after another
+    for (const auto& [shader, path] : shaders) {
+        // Already names the file it came from
+        Error err = checkCompile(shader, path);
+        if (err) {
+            fail(err.value());
+        }
+    }
 
-        GLint count;
-        glGetProgramiv(next_prog, GL_ACTIVE_UNIFORMS, &count);
-        uniforms_.clear();
-        for (GLuint i = 0; i < (GLuint)count; i++)
-        {
-            std::vector<GLchar> name(static_cast<size_t>(uni_name_len));
+    if (!errors.empty()) {
+        built.err = errors;
+    }
 
-            GLsizei length;
-            GLint size;
-            GLenum type;
-            glGetActiveUniform(next_prog, i, uni_name_len, &length, &size, &type, &name[0]);
+    if (!built.err) {
+        built.program = glCreateProgram();
+        for (const auto& kv : shaders) {
+            glAttachShader(built.program, kv.first);
+        }
 
-            GLint loc = glGetUniformLocation(next_prog, name.data());
-            uniforms_[std::string(name.data())] = loc;
+        if (request.cache) {
+            glProgramParameteri(built.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         }
 
-        // Change out the program
-        glDeleteProgram(program_);
-        program_ = next_prog;
+        glLinkProgram(built.program);
+        built.err = checkLink(built.program);
+        if (built.err) {
+            glDeleteProgram(built.program);
+            built.program = GL_FALSE;
+        } else {
+            applyBlockBindings(built.program, request.block_bindings);
+        }
+    }
 
-        should_switch_ = false;
+    // A linked program doesn't need its shaders any more
+    for (const auto& kv : shaders) {
+        glDeleteShader(kv.first);
     }
 
-    set_uniforms_.clear();
+    if (request.cache && built.program != GL_FALSE) {
+        Error err = request.cache->store(key, built.program);
+        if (err) {
+            std::cerr << "Warning: unable to cache shader program: " << err.value() << std::endl;
+        }
+    }
 
-    return {};
+    return built;
 }
 
-std::optional<GLint> ShaderProgram::getUniformLoc(std::string name) {
-    if (!uniforms_.count(name)) {
-        return {};
+Error ShaderProgram::update() {
+    // Files saved together arrive together, so they cost one rebuild
+    std::vector<std::filesystem::path> changed = watcher_.poll();
+    bool dirty = std::any_of(sources_.begin(), sources_.end(), [this, &changed](const Sources::value_type& stage) {
+        return isDirty(stage, changed);
+    });
+
+    // Either way the last good program keeps running until a new one is ready
+    if (compiler_) {
+        if (dirty) {
+            compiler_->submit(this, [request = makeRequest()]() { return build(request); });
+        }
+
+        std::optional<Build> built = compiler_->collect(this);
+        if (built) {
+            adopt(built.value());
+        }
+    } else if (dirty) {
+        link();
+    }
+
+    if (last_err_) {
+        return last_err_;
     }
 
-    return uniforms_.at(name);
+    uniforms_.beginFrame();
+
+    return {};
 }
 
 GLuint ShaderProgram::getProgram() {
     return program_;
 }
 #undef MAX_UNIFORM_NAME_LEN
+#undef MAX_INCLUDE_DEPTH
@@ -3,43 +3,80 @@
 
 #include <filesystem>
 #include <map>
-#include <functional>
+#include <memory>
 #include <vector>
 
 #include <GL/glew.h>
 
 #include "Result.h"
+#include "UniformRegistry.h"
+#include "FileWatcher.h"
+#include "ShaderCompiler.h"
+#include "ProgramCache.h"
 
 class ShaderProgram {
     public:
         using ShaderHandle = GLuint;
         using ProgramHandle = GLuint;
 
-        struct Shader {
-            ShaderHandle handle;
-            std::filesystem::file_time_type last_modified;
-            std::filesystem::path path;
-            GLenum type;
-        };
-
         ShaderProgram();
         ~ShaderProgram();
 
+        // Adds a stage to build by the next link(). Only fails if it can't be read.
         Error loadShader(GLenum type, const std::string& path);
+        void addInclude(const std::string& name, const std::string& source);
+        void bindUniformBlock(const std::string& name, GLuint binding);
+        // Where linked programs are kept between runs, checked before compiling
+        void setCache(std::shared_ptr<ProgramCache> cache);
+        // Builds the loaded stages in line, keeping the current program if it fails
+        Error link();
+        // Rebuild changed shaders on compiler's thread instead of in update(),
+        // which must outlive us. Without one they're rebuilt in line.
+        void setCompiler(ShaderCompiler* compiler);
+        // Reloads shaders whose files changed and relinks. Returns the last
+        // load or link error until a change fixes it.
         Error update();
         ShaderHandle getProgram();
 
-        std::optional<GLint> getUniformLoc(std::string name);
-        void setUniform(const std::string& name, std::function<void(GLint&)> f);
-        void markUniformInUse(const std::string& name);
+        UniformRegistry& getUniforms();
         std::vector<std::string> getUnsetUniforms();
 
     private:
-        std::map<GLenum, Shader> shaders_;
-        std::map<std::string, GLint> uniforms_;
-        std::vector<GLint> set_uniforms_;
-        bool should_switch_ = false;
+        using Sources = std::map<GLenum, std::vector<std::filesystem::path>>;
+
+        // What the compile thread needs, copied so it never touches our state
+        struct BuildRequest {
+            std::map<GLenum, std::filesystem::path> stages;
+            std::map<std::string, std::string> includes;
+            std::map<std::string, GLuint> block_bindings;
+            std::shared_ptr<const ProgramCache> cache;
+        };
+
+        using Build = ShaderCompiler::Build;
+
+        BuildRequest makeRequest() const;
+        void adopt(Build& built);
+        static Error resolveIncludes(const std::map<std::string, std::string>& includes, const std::string& source, const std::filesystem::path& dir, std::string& out, int depth, std::vector<std::filesystem::path>& files);
+        static Error readStage(const std::filesystem::path& path, const std::map<std::string, std::string>& includes, std::string& source, std::vector<std::filesystem::path>& files);
+        static ShaderHandle compile(GLenum type, const std::string& source);
+        static Error checkCompile(ShaderHandle shader, const std::filesystem::path& path);
+        static Error checkLink(ProgramHandle program);
+        static void applyBlockBindings(ProgramHandle program, const std::map<std::string, GLuint>& bindings);
+        bool isDirty(const Sources::value_type& stage, const std::vector<std::filesystem::path>& changed);
+        void watchSources();
+
+        static Build build(const BuildRequest& request);
+
+        // Each stage's file and the files it includes, as of the last attempt to load it
+        Sources sources_;
+        FileWatcher watcher_;
+        Error last_err_;
+        std::map<std::string, std::string> includes_;
+        std::map<std::string, GLuint> block_bindings_;
+        UniformRegistry uniforms_;
         ProgramHandle program_;
+        std::shared_ptr<ProgramCache> cache_;
+        ShaderCompiler* compiler_ = nullptr;
 };
 
 #endif
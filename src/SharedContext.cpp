@@ -0,0 +1,37 @@
+#include "SharedContext.h"
+
+namespace {
+    class HiddenWindowContext : public SharedContext {
+        public:
+            HiddenWindowContext(GLFWwindow* window) : window_(window) {}
+
+            ~HiddenWindowContext() {
+                glfwDestroyWindow(window_);
+            }
+
+            bool makeCurrent() override {
+                glfwMakeContextCurrent(window_);
+                return glfwGetCurrentContext() == window_;
+            }
+
+            void release() override {
+                glfwMakeContextCurrent(NULL);
+            }
+
+        private:
+            GLFWwindow* window_;
+    };
+}
+
+std::unique_ptr<SharedContext> SharedContext::createHidden(GLFWwindow* window) {
+    // The other hints stick around from creating the main window
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* hidden = glfwCreateWindow(1, 1, "", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (!hidden) {
+        return nullptr;
+    }
+
+    return std::make_unique<HiddenWindowContext>(hidden);
+}
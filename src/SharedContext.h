@@ -0,0 +1,24 @@
+#ifndef SHARED_CONTEXT_H
+#define SHARED_CONTEXT_H
+
+#include <memory>
+
+#include <GLFW/glfw3.h>
+
+// A second OpenGL context sharing objects (programs, textures, buffers) with
+// the one we render with, so slow GL work can happen on another thread.
+// Container objects like framebuffers and vertex arrays are not shared.
+class SharedContext {
+    public:
+        virtual ~SharedContext() = default;
+
+        // Called from the thread that's going to use it, which should release it before exiting
+        virtual bool makeCurrent() = 0;
+        virtual void release() = 0;
+
+        // A hidden 1x1 window sharing window's context, with the same context hints.
+        // GLFW wants it created and destroyed on the main thread. Returns nullptr on failure.
+        static std::unique_ptr<SharedContext> createHidden(GLFWwindow* window);
+};
+
+#endif
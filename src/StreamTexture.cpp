@@ -0,0 +1,129 @@
+#include "StreamTexture.h"
+
+#include <cstring>
+
+StreamTexture::StreamTexture(size_t slots) : slots_(slots) {}
+
+StreamTexture::~StreamTexture() {
+    releaseBuffers();
+
+    if (tex_id_ != GL_FALSE) {
+        glDeleteTextures(1, &tex_id_);
+    }
+}
+
+void StreamTexture::setup() {
+    persistent_ = GLEW_ARB_buffer_storage;
+}
+
+void StreamTexture::releaseBuffers() {
+    for (auto& slot : slots_) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+
+        if (slot.pbo != GL_FALSE) {
+            if (slot.mapped) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                slot.mapped = nullptr;
+            }
+
+            glDeleteBuffers(1, &slot.pbo);
+            slot.pbo = GL_FALSE;
+        }
+    }
+}
+
+void StreamTexture::allocate(GLsizei width, GLsizei height) {
+    // Immutable storage can't be resized, so a new size gets a new texture
+    if (tex_id_ != GL_FALSE) {
+        glDeleteTextures(1, &tex_id_);
+    }
+
+    glGenTextures(1, &tex_id_);
+    glBindTexture(GL_TEXTURE_2D, tex_id_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // Sized for the largest client format we take (4 bytes per pixel)
+    releaseBuffers();
+    slot_size_ = static_cast<GLsizeiptr>(width) * height * 4;
+    for (auto& slot : slots_) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+
+        if (persistent_) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slot_size_, NULL, flags);
+            slot.mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slot_size_, flags));
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slot_size_, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    width_ = width;
+    height_ = height;
+    next_slot_ = 0;
+}
+
+void StreamTexture::upload(const unsigned char* pixels, GLsizei width, GLsizei height, GLenum format) {
+    if (width != width_ || height != height_ || tex_id_ == GL_FALSE) {
+        allocate(width, height);
+    }
+
+    size_t channels = (format == GL_RGBA || format == GL_BGRA) ? 4 : 3;
+    size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * channels;
+
+    Slot& slot = slots_[next_slot_];
+    next_slot_ = (next_slot_ + 1) % slots_.size();
+
+    // The copy out of this buffer was issued slots_.size() frames ago, so this rarely waits
+    if (slot.fence) {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    if (persistent_) {
+        std::memcpy(slot.mapped, pixels, size);
+    } else {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size), flags);
+        if (mapped) {
+            std::memcpy(mapped, pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, tex_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint StreamTexture::getID() const {
+    return tex_id_;
+}
+
+GLsizei StreamTexture::getWidth() const {
+    return width_;
+}
+
+GLsizei StreamTexture::getHeight() const {
+    return height_;
+}
@@ -0,0 +1,46 @@
+#ifndef STREAM_TEXTURE_H
+#define STREAM_TEXTURE_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+// A texture fed a new frame every so often (webcams, video). Storage is only
+// allocated when the frame size changes, and frames travel through a ring of
+// pixel unpack buffers so glTexSubImage2D can copy asynchronously instead of
+// stalling on client memory. With ARB_buffer_storage the buffers stay mapped
+// for their whole life; without it each is mapped unsynchronized per upload.
+class StreamTexture {
+    public:
+        StreamTexture(size_t slots=3);
+        ~StreamTexture();
+
+        void setup();
+        // Rows of width * channels(format) bytes, first row at the bottom of the texture (t=0)
+        void upload(const unsigned char* pixels, GLsizei width, GLsizei height, GLenum format);
+        GLuint getID() const;
+        GLsizei getWidth() const;
+        GLsizei getHeight() const;
+
+    private:
+        struct Slot {
+            GLuint pbo = GL_FALSE;
+            GLsync fence = nullptr;
+            unsigned char* mapped = nullptr;
+        };
+
+        void allocate(GLsizei width, GLsizei height);
+        void releaseBuffers();
+
+        std::vector<Slot> slots_;
+        size_t next_slot_ = 0;
+        GLsizeiptr slot_size_ = 0;
+        bool persistent_ = false;
+
+        GLuint tex_id_ = GL_FALSE;
+        GLsizei width_ = 0;
+        GLsizei height_ = 0;
+};
+
+#endif
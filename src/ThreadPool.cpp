@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads, size_t max_queued) : max_queued_(std::max<size_t>(max_queued, 1)) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back([this]{ run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(mutex_);
+        running_ = false;
+    }
+
+    // Queued jobs still run before the workers exit
+    job_ready_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Job job) {
+    std::unique_lock lock(mutex_);
+    job_taken_.wait(lock, [this]{ return jobs_.size() < max_queued_; });
+
+    jobs_.push_back(std::move(job));
+    lock.unlock();
+
+    job_ready_.notify_one();
+}
+
+bool ThreadPool::trySubmit(Job job) {
+    std::unique_lock lock(mutex_);
+    if (jobs_.size() >= max_queued_) {
+        return false;
+    }
+
+    jobs_.push_back(std::move(job));
+    lock.unlock();
+
+    job_ready_.notify_one();
+    return true;
+}
+
+bool ThreadPool::isFull() {
+    std::lock_guard guard(mutex_);
+    return jobs_.size() >= max_queued_;
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this]{ return jobs_.empty() && busy_ == 0; });
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return threads_.size();
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        job_ready_.wait(lock, [this]{ return !jobs_.empty() || !running_; });
+        if (jobs_.empty()) {
+            return;
+        }
+
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_++;
+        lock.unlock();
+        job_taken_.notify_one();
+
+        job();
+
+        lock.lock();
+        busy_--;
+        bool idle = jobs_.empty() && busy_ == 0;
+        lock.unlock();
+
+        if (idle) {
+            idle_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling from a bounded job queue. submit() blocks
+// while max_queued jobs are already waiting, which pushes back on producers
+// that outrun the workers instead of letting the queue grow without limit.
+// Producers that mustn't wait use trySubmit() and drop the job instead.
+class ThreadPool {
+    public:
+        using Job = std::function<void()>;
+
+        ThreadPool(size_t threads, size_t max_queued);
+        ~ThreadPool();
+
+        void submit(Job job);
+        // Queues job only if there's room, never waits
+        bool trySubmit(Job job);
+        bool isFull();
+        void wait();
+        size_t getThreadCount() const;
+
+    private:
+        void run();
+
+        std::mutex mutex_;
+        std::condition_variable job_ready_;
+        std::condition_variable job_taken_;
+        std::condition_variable idle_;
+        std::deque<Job> jobs_;
+        size_t max_queued_;
+        size_t busy_ = 0;
+        bool running_ = true;
+        std::vector<std::thread> threads_;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer handoff of the newest value.
+// The producer always has a slot of its own to write into and the consumer
+// always has one to read from; the third sits in the middle and is swapped
+// with either side by a single atomic exchange. Neither side ever waits on
+// the other and nothing is copied during the handoff. Slots are reused, so
+// a value being written may hold whatever was published three turns ago.
+template<typename T>
+class TripleBuffer {
+    public:
+        // Producer: fill this, then publish()
+        T& getWriteBuffer() {
+            return buffers_[write_];
+        }
+
+        void publish() {
+            write_ = middle_.exchange(static_cast<uint8_t>(write_ | FRESH), std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Consumer: take the newest published value if there is one we haven't seen
+        bool update() {
+            if (!(middle_.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+
+            read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        T& getReadBuffer() {
+            return buffers_[read_];
+        }
+
+    private:
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4;
+
+        T buffers_[3];
+        uint8_t write_ = 0;
+        uint8_t read_ = 1;
+        std::atomic<uint8_t> middle_{2};
+};
+
+#endif
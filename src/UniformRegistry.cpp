@@ -0,0 +1,124 @@
+#include "UniformRegistry.h"
+
+UniformRegistry::Slot UniformRegistry::add(const std::string& name) {
+    auto it = slots_.find(name);
+    if (it != slots_.end()) {
+        return it->second;
+    }
+
+    Entry entry;
+    entry.name = name;
+    if (program_ != 0) {
+        entry.location = glGetUniformLocation(program_, name.c_str());
+    }
+
+    entries_.push_back(entry);
+    Slot slot = entries_.size() - 1;
+    slots_[name] = slot;
+
+    return slot;
+}
+
+void UniformRegistry::link(GLuint program) {
+    program_ = program;
+
+    // A fresh program has default values, so forget everything we shadowed
+    for (auto& entry : entries_) {
+        entry.location = glGetUniformLocation(program, entry.name.c_str());
+        entry.type = Type::None;
+        entry.set = false;
+    }
+
+    // Make sure every active uniform has a slot so unset ones can be reported
+    GLint uni_name_len = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uni_name_len);
+
+    GLint count;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    std::vector<GLchar> name(static_cast<size_t>(uni_name_len));
+    for (GLuint i = 0; i < (GLuint)count; i++) {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, uni_name_len, &length, &size, &type, &name[0]);
+
+        add(std::string(name.data()));
+    }
+}
+
+void UniformRegistry::beginFrame() {
+    for (auto& entry : entries_) {
+        entry.set = false;
+    }
+}
+
+bool UniformRegistry::isActive(Slot slot) const {
+    return entries_[slot].location >= 0;
+}
+
+void UniformRegistry::set(Slot slot, GLint v) {
+    Entry& entry = entries_[slot];
+    if (entry.location < 0) {
+        return;
+    }
+
+    entry.set = true;
+    if (entry.type == Type::Int && entry.i == v) {
+        return;
+    }
+
+    glProgramUniform1i(program_, entry.location, v);
+    entry.type = Type::Int;
+    entry.i = v;
+}
+
+void UniformRegistry::set(Slot slot, GLfloat v) {
+    Entry& entry = entries_[slot];
+    if (entry.location < 0) {
+        return;
+    }
+
+    entry.set = true;
+    if (entry.type == Type::Float && entry.f[0] == v) {
+        return;
+    }
+
+    glProgramUniform1f(program_, entry.location, v);
+    entry.type = Type::Float;
+    entry.f[0] = v;
+}
+
+void UniformRegistry::set(Slot slot, GLfloat x, GLfloat y) {
+    Entry& entry = entries_[slot];
+    if (entry.location < 0) {
+        return;
+    }
+
+    entry.set = true;
+    if (entry.type == Type::Vec2 && entry.f[0] == x && entry.f[1] == y) {
+        return;
+    }
+
+    glProgramUniform2f(program_, entry.location, x, y);
+    entry.type = Type::Vec2;
+    entry.f[0] = x;
+    entry.f[1] = y;
+}
+
+void UniformRegistry::markInUse(Slot slot) {
+    Entry& entry = entries_[slot];
+    if (entry.location >= 0) {
+        entry.set = true;
+    }
+}
+
+std::vector<std::string> UniformRegistry::getUnset() const {
+    std::vector<std::string> unset;
+    for (const auto& entry : entries_) {
+        if (entry.location >= 0 && !entry.set) {
+            unset.push_back(entry.name);
+        }
+    }
+
+    return unset;
+}
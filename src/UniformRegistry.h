@@ -0,0 +1,45 @@
+#ifndef UNIFORM_REGISTRY_H
+#define UNIFORM_REGISTRY_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Maps uniform names to integer slots that survive relinking. Locations are
+// resolved once per link and the last value sent is shadowed, so setting an
+// unchanged value costs a comparison rather than a GL call.
+class UniformRegistry {
+    public:
+        using Slot = size_t;
+
+        Slot add(const std::string& name);
+        void link(GLuint program);
+        void beginFrame();
+
+        bool isActive(Slot slot) const;
+        void set(Slot slot, GLint v);
+        void set(Slot slot, GLfloat v);
+        void set(Slot slot, GLfloat x, GLfloat y);
+        void markInUse(Slot slot);
+        std::vector<std::string> getUnset() const;
+
+    private:
+        enum class Type { None, Int, Float, Vec2 };
+
+        struct Entry {
+            std::string name;
+            GLint location = -1;
+            bool set = false;
+            Type type = Type::None;
+            GLint i = 0;
+            GLfloat f[2] = {};
+        };
+
+        GLuint program_ = 0;
+        std::vector<Entry> entries_;
+        std::unordered_map<std::string, Slot> slots_;
+};
+
+#endif
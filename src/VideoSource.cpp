@@ -0,0 +1,216 @@
+#include "VideoSource.h"
+
+#include <cmath>
+#include <iostream>
+
+// How far past the decoded frames a jump has to land before seeking beats decoding up to it
+#define SEEK_AHEAD 1.0
+
+VideoSource::VideoSource(const std::filesystem::path& path, VideoSettings settings, size_t queue_size)
+    : path_(path), settings_(settings), queue_size_(std::max<size_t>(queue_size, 1)) {
+}
+
+VideoSource::~VideoSource() {
+    stop();
+}
+
+Error VideoSource::startIf() {
+    // Unlike a camera a file isn't going to appear later, so one attempt is all it gets
+    if (started_) {
+        return open_err_;
+    }
+    started_ = true;
+
+    if (!video_.open(path_.string())) {
+        open_err_ = "Unable to open video " + path_.string();
+        return open_err_;
+    }
+
+    double fps = video_.get(cv::CAP_PROP_FPS);
+    if (fps > 0 && std::isfinite(fps)) {
+        frame_period_ = 1.0 / fps;
+    }
+
+    double frames = video_.get(cv::CAP_PROP_FRAME_COUNT);
+    if (frames > 0) {
+        duration_ = frames * frame_period_;
+    }
+
+    std::cerr << "Video " << path_.string() << ": "
+        << video_.get(cv::CAP_PROP_FRAME_WIDTH) << "x" << video_.get(cv::CAP_PROP_FRAME_HEIGHT)
+        << " @ " << 1.0 / frame_period_ << " fps, " << duration_ << " s" << std::endl;
+
+    running_ = true;
+    thread_ = std::thread([this]{ run(); });
+
+    return {};
+}
+
+void VideoSource::stop() {
+    {
+        std::lock_guard guard(mutex_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// Expects mutex_ to be held
+void VideoSource::requestSeek(double t) {
+    seek_pending_ = true;
+    seek_target_ = t;
+    // The old frame stays on screen, but it's no reference for where we are anymore
+    has_current_ = false;
+    cond_.notify_one();
+}
+
+const cv::Mat* VideoSource::read(double t) {
+    if (settings_.wall_clock) {
+        Clock::time_point now = Clock::now();
+        if (clock_start_ == Clock::time_point()) {
+            clock_start_ = now;
+        }
+        t = std::chrono::duration<double>(now - clock_start_).count();
+    }
+
+    std::lock_guard guard(mutex_);
+    if (seek_pending_) {
+        return nullptr;
+    }
+
+    bool behind = has_current_ && t < current_.time - frame_period_ / 2;
+    bool ahead = !eof_ && (queue_.empty()
+        ? has_current_ && t > current_.time + SEEK_AHEAD
+        : t > queue_.back().time + SEEK_AHEAD);
+    if (behind || ahead) {
+        requestSeek(t);
+        return nullptr;
+    }
+
+    // Take the newest frame that's due, recycling the ones it replaces
+    bool changed = false;
+    while (!queue_.empty() && queue_.front().time <= t) {
+        if (changed) {
+            stats_.skipped++;
+        }
+
+        std::swap(current_, queue_.front());
+        free_.push_back(std::move(queue_.front().image));
+        queue_.pop_front();
+        changed = true;
+    }
+
+    if (!changed) {
+        return nullptr;
+    }
+
+    has_current_ = true;
+    cond_.notify_one();
+
+    return &current_.image;
+}
+
+void VideoSource::run() {
+    // Unwrapped time of the start of this pass through the file, and our frame within it
+    double base = 0;
+    double index = 0;
+    cv::Mat image;
+
+    std::unique_lock lock(mutex_);
+    while (running_) {
+        if (seek_pending_) {
+            double target = seek_target_;
+            seek_pending_ = false;
+            eof_ = false;
+
+            for (auto& frame : queue_) {
+                free_.push_back(std::move(frame.image));
+            }
+            queue_.clear();
+            stats_.seeks++;
+
+            base = 0;
+            if (settings_.loop && duration_ > 0) {
+                base = std::floor(target / duration_) * duration_;
+            }
+
+            lock.unlock();
+            video_.set(cv::CAP_PROP_POS_MSEC, std::max(target - base, 0.0) * 1000);
+            // Containers land on keyframes, so ask where we actually are
+            index = video_.get(cv::CAP_PROP_POS_FRAMES);
+            lock.lock();
+            continue;
+        }
+
+        if (eof_ || queue_.size() >= queue_size_) {
+            cond_.wait(lock);
+            continue;
+        }
+
+        cv::Mat out;
+        if (!free_.empty()) {
+            out = std::move(free_.back());
+            free_.pop_back();
+        }
+
+        // Decode without holding the lock so read() never waits on us
+        lock.unlock();
+        bool ok = video_.read(image);
+        if (ok) {
+            cv::flip(image, out, 0);
+        }
+        lock.lock();
+
+        // Decoded from where we were before the seek, throw it away
+        if (seek_pending_) {
+            free_.push_back(std::move(out));
+            continue;
+        }
+
+        if (!ok) {
+            free_.push_back(std::move(out));
+
+            // Nothing decoded this pass means the file is broken, not finished
+            if (!settings_.loop || index <= 0) {
+                eof_ = true;
+                continue;
+            }
+
+            // The container's frame count is only a guess, this is the real length
+            duration_ = index * frame_period_;
+            base += duration_;
+            index = 0;
+
+            lock.unlock();
+            video_.set(cv::CAP_PROP_POS_FRAMES, 0);
+            lock.lock();
+            continue;
+        }
+
+        queue_.push_back(Frame{base + index * frame_period_, std::move(out)});
+        index++;
+        stats_.decoded++;
+    }
+}
+
+int VideoSource::getWidth() const {
+    return current_.image.cols;
+}
+
+int VideoSource::getHeight() const {
+    return current_.image.rows;
+}
+
+const std::filesystem::path& VideoSource::getPath() const {
+    return path_;
+}
+
+VideoSource::Stats VideoSource::getStats() {
+    std::lock_guard guard(mutex_);
+    return stats_;
+}
+
+#undef SEEK_AHEAD
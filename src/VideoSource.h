@@ -0,0 +1,94 @@
+#ifndef VIDEO_SOURCE_H
+#define VIDEO_SOURCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "Result.h"
+
+struct VideoSettings {
+    bool loop = true;
+    // Follow a clock of our own started on the first read instead of the time passed in
+    bool wall_clock = false;
+};
+
+// Plays a video file. A background thread decodes ahead into a bounded queue
+// and read() picks whichever frame is due at the given time, so the render
+// thread never waits on the decoder. Frames come out upload-ready like
+// Webcam's: packed BGR, first row at the bottom (but not mirrored).
+//
+// Times are "unwrapped": when looping, the second pass through a 10 second
+// clip runs from 10 to 20. Jumping backwards or well past what's been decoded
+// seeks, and the last frame shown stays up until the decoder catches up.
+class VideoSource {
+    public:
+        struct Stats {
+            size_t decoded = 0;
+            size_t skipped = 0;
+            size_t seeks = 0;
+        };
+
+        VideoSource(const std::filesystem::path& path, VideoSettings settings={}, size_t queue_size=8);
+        ~VideoSource();
+
+        Error startIf();
+        void stop();
+
+        // The frame due at t seconds if it's not the one last returned, or nullptr.
+        // Valid until the next call. Never blocks.
+        const cv::Mat* read(double t);
+
+        // Size of the last frame returned by read()
+        int getWidth() const;
+        int getHeight() const;
+        const std::filesystem::path& getPath() const;
+        Stats getStats();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Frame {
+            double time = 0;
+            cv::Mat image;
+        };
+
+        void run();
+        void requestSeek(double t);
+
+        std::filesystem::path path_;
+        VideoSettings settings_;
+        size_t queue_size_;
+        cv::VideoCapture video_;
+        std::thread thread_;
+        Error open_err_;
+        bool started_ = false;
+
+        // Shared with the decoder
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::deque<Frame> queue_;
+        // Decoded images go back here once shown so their buffers get reused
+        std::vector<cv::Mat> free_;
+        bool running_ = false;
+        bool seek_pending_ = false;
+        double seek_target_ = 0;
+        bool eof_ = false;
+        double frame_period_ = 1.0 / 30;
+        // Length of one pass, refined when the decoder actually reaches the end
+        double duration_ = 0;
+        Stats stats_;
+
+        // Only touched by the reading thread
+        Frame current_;
+        bool has_current_ = false;
+        Clock::time_point clock_start_;
+};
+
+#endif
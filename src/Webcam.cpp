@@ -1,23 +1,60 @@
 #include "Webcam.h"
 
-#include <string>
+#include <algorithm>
+#include <iostream>
 
-Webcam::Webcam(int device) : running_(false), new_frame_(false), device_(device) {
+#define REOPEN_INTERVAL std::chrono::seconds(2)
+#define MIN_BACKOFF std::chrono::milliseconds(5)
+#define MAX_BACKOFF std::chrono::milliseconds(500)
+
+Webcam::Webcam(int device, WebcamSettings settings) : running_(false), device_(device), settings_(settings) {
 }
 
 Webcam::~Webcam() {
     stop();
 }
 
-bool Webcam::read(cv::OutputArray& out) {
-    std::lock_guard guard(frame_mutex_);
-    if (new_frame_) {
-        new_frame_ = false;
-        frame_.copyTo(out);
-        return true;
+const cv::Mat* Webcam::read() {
+    if (frames_.update()) {
+        return &frames_.getReadBuffer();
+    }
+
+    return nullptr;
+}
+
+Error Webcam::open() {
+    if (!webcam_.open(device_)) {
+        return "Unable to open capture device " + std::to_string(device_);
+    }
+
+    // Format has to go first, drivers pick the sizes and rates available per format
+    if (!settings_.format.empty()) {
+        const std::string& f = settings_.format;
+        webcam_.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc(f[0], f[1], f[2], f[3]));
+    }
+
+    if (settings_.width > 0 && settings_.height > 0) {
+        webcam_.set(cv::CAP_PROP_FRAME_WIDTH, settings_.width);
+        webcam_.set(cv::CAP_PROP_FRAME_HEIGHT, settings_.height);
+    }
+
+    if (settings_.fps > 0) {
+        webcam_.set(cv::CAP_PROP_FPS, settings_.fps);
+    }
+
+    // Report what we actually got, drivers are free to round to the nearest mode
+    int fourcc = static_cast<int>(webcam_.get(cv::CAP_PROP_FOURCC));
+    std::string format;
+    for (int i = 0; i < 4; i++) {
+        char c = static_cast<char>((fourcc >> (8 * i)) & 0xFF);
+        format += (c >= ' ' && c <= '~') ? c : '?';
     }
 
-    return false;
+    std::cerr << "Capture device " << device_ << ": "
+        << webcam_.get(cv::CAP_PROP_FRAME_WIDTH) << "x" << webcam_.get(cv::CAP_PROP_FRAME_HEIGHT)
+        << " @ " << webcam_.get(cv::CAP_PROP_FPS) << " fps, " << format << std::endl;
+
+    return {};
 }
 
 Error Webcam::startIf() {
@@ -25,37 +62,93 @@ Error Webcam::startIf() {
         return {};
     }
 
-    webcam_.open(device_);
-    if (!webcam_.isOpened()) {
-        return "Unable to open capture device " + std::to_string(device_);
+    Clock::time_point now = Clock::now();
+    if (last_open_err_ && now - last_open_attempt_ < REOPEN_INTERVAL) {
+        return last_open_err_;
+    }
+
+    last_open_attempt_ = now;
+    last_open_err_ = open();
+    if (last_open_err_) {
+        return last_open_err_;
     }
 
     running_ = true;
-    thread_ = std::thread([this]{
-        while (running_.load()) {
-            cv::Mat frame;
-            if (webcam_.read(frame)) {
-                frame_mutex_.lock();
-                size_ = frame.size();
-                frame_ = frame;
-                new_frame_ = true;
-                frame_mutex_.unlock();
+    thread_ = std::thread([this]{ run(); });
+
+    return {};
+}
+
+void Webcam::run() {
+    cv::Mat frame;
+    Clock::time_point last_frame;
+    std::chrono::milliseconds backoff = MIN_BACKOFF;
+
+    while (running_.load()) {
+        // grab() blocks in the driver until the device has a frame for us
+        Clock::time_point grab_start = Clock::now();
+        bool ok = webcam_.grab();
+        Clock::time_point grab_end = Clock::now();
+        ok = ok && webcam_.retrieve(frame);
+        Clock::time_point retrieve_end = Clock::now();
+
+        if (!ok) {
+            // A missing or stalled device returns immediately, don't spin on it
+            {
+                std::lock_guard guard(stats_mutex_);
+                stats_.failures++;
             }
+
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min<std::chrono::milliseconds>(backoff * 2, MAX_BACKOFF);
+            continue;
         }
-    });
+        backoff = MIN_BACKOFF;
 
-    return {};
+        // Flip straight into the slot we own, off the render thread, so
+        // frames are ready to upload as-is. Once slots have been sized
+        // by the first frames this doesn't allocate either.
+        cv::flip(frame, frames_.getWriteBuffer(), -1);
+        frames_.publish();
+
+        std::lock_guard guard(stats_mutex_);
+        if (stats_.frames > 0) {
+            double interval = std::chrono::duration<double, std::milli>(grab_end - last_frame).count();
+            stats_.interval_ms_total += interval;
+            stats_.interval_ms_max = std::max(stats_.interval_ms_max, interval);
+        }
+        stats_.grab_ms_total += std::chrono::duration<double, std::milli>(grab_end - grab_start).count();
+        stats_.retrieve_ms_total += std::chrono::duration<double, std::milli>(retrieve_end - grab_end).count();
+        stats_.frames++;
+        last_frame = grab_end;
+    }
 }
 
+// Size of the last frame handed out by read(), so only meaningful on the reading thread
 int Webcam::getWidth() {
-    return size_.width;
+    return frames_.getReadBuffer().cols;
 }
 
 int Webcam::getHeight() {
-    return size_.height;
+    return frames_.getReadBuffer().rows;
+}
+
+int Webcam::getDevice() const {
+    return device_;
+}
+
+Webcam::Stats Webcam::getStats() {
+    std::lock_guard guard(stats_mutex_);
+    return stats_;
 }
 
 void Webcam::stop() {
     running_ = false;
-    thread_.join();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
 }
+
+#undef REOPEN_INTERVAL
+#undef MIN_BACKOFF
+#undef MAX_BACKOFF
@@ -1,35 +1,72 @@
 #ifndef WEBCAM_H
 #define WEBCAM_H
 
-#include <mutex>
 #include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
 #include <thread>
 
 #include <opencv2/opencv.hpp>
 
 #include "Result.h"
+#include "TripleBuffer.h"
+
+// What to ask the device for. Zero/empty leaves the driver's default.
+struct WebcamSettings {
+    int width = 0;
+    int height = 0;
+    double fps = 0;
+    // FOURCC, e.g. MJPG or YUYV
+    std::string format;
+};
 
+// Captures from a device on a background thread. Frames come out of read()
+// upload-ready: packed BGR, rotated so the first row is the bottom of the image
+// as OpenGL expects (which also mirrors it, like looking in a mirror).
 class Webcam {
     public:
+        struct Stats {
+            size_t frames = 0;
+            size_t failures = 0;
+            double interval_ms_total = 0;
+            double interval_ms_max = 0;
+            double grab_ms_total = 0;
+            double retrieve_ms_total = 0;
+        };
+
         ~Webcam();
-        Webcam(int device);
+        Webcam(int device, WebcamSettings settings={});
         Error startIf();
         void stop();
-        bool read(cv::OutputArray& out);
+
+        // Newest frame not yet read, or nullptr. Valid until the next call. Never blocks.
+        const cv::Mat* read();
 
         int getHeight();
         int getWidth();
+        int getDevice() const;
+        Stats getStats();
 
     private:
-        std::mutex frame_mutex_;
-        cv::Mat frame_;
+        using Clock = std::chrono::steady_clock;
+
+        Error open();
+        void run();
+
+        TripleBuffer<cv::Mat> frames_;
         cv::VideoCapture webcam_;
         std::thread thread_;
         std::atomic<bool> running_;
-        bool new_frame_;
         int device_;
-        cv::Size size_;
+        WebcamSettings settings_;
+
+        // Failed opens are only retried every so often, startIf() is called every frame
+        Clock::time_point last_open_attempt_;
+        Error last_open_err_;
+
+        std::mutex stats_mutex_;
+        Stats stats_;
 };
 
 #endif
-
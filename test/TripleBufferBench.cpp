@@ -0,0 +1,73 @@
+// Times the consumer side of a TripleBuffer, which is all Webcam::read() does,
+// while a producer publishes 720p BGR frames as fast as it can copy them. The
+// render thread should never wait, so every call should cost about the same
+// whether or not the producer is mid-frame.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "TripleBuffer.h"
+
+#define CALLS 200000
+#define FRAME_BYTES (1280 * 720 * 3)
+
+using Clock = std::chrono::steady_clock;
+using Frame = std::vector<unsigned char>;
+
+int main() {
+    TripleBuffer<Frame> frames;
+    std::atomic<bool> running(true);
+
+    const Frame source(FRAME_BYTES, 0x80);
+    std::thread producer([&frames, &running, &source]() {
+        while (running) {
+            // Like the capture thread's flip into the write buffer
+            Frame& frame = frames.getWriteBuffer();
+            frame.resize(source.size());
+            std::memcpy(frame.data(), source.data(), source.size());
+            frames.publish();
+        }
+    });
+
+    std::vector<double> ns;
+    ns.reserve(CALLS);
+    size_t fresh = 0;
+    for (size_t i = 0; i < CALLS; i++) {
+        Clock::time_point start = Clock::now();
+        const Frame* frame = frames.update() ? &frames.getReadBuffer() : nullptr;
+        Clock::time_point end = Clock::now();
+
+        ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        if (frame) {
+            fresh++;
+        }
+    }
+
+    running = false;
+    producer.join();
+
+    std::sort(ns.begin(), ns.end());
+    auto percentile = [&ns](double p) {
+        return ns[std::min(ns.size() - 1, static_cast<size_t>(p / 100.0 * static_cast<double>(ns.size())))];
+    };
+
+    std::cout << "{"
+        << "\"calls\": " << CALLS << ", "
+        << "\"fresh\": " << fresh << ", "
+        << "\"unit\": \"ns\", "
+        << "\"p50\": " << percentile(50) << ", "
+        << "\"p99\": " << percentile(99) << ", "
+        << "\"p99.9\": " << percentile(99.9) << ", "
+        << "\"max\": " << ns.back()
+        << "}" << std::endl;
+
+    return 0;
+}
+
+#undef CALLS
+#undef FRAME_BYTES
@@ -0,0 +1,87 @@
+// Hammers a TripleBuffer with a producer and consumer running flat out. Every
+// frame is filled with its own sequence number, so a frame mixing two numbers
+// was torn and one older than the last taken is stale.
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "TripleBuffer.h"
+
+#define FRAMES 2000000
+#define FRAME_WORDS 256
+
+using Frame = std::vector<uint64_t>;
+
+int main() {
+    TripleBuffer<Frame> frames;
+    std::atomic<bool> done(false);
+
+    std::thread producer([&frames, &done]() {
+        for (uint64_t seq = 1; seq <= FRAMES; seq++) {
+            Frame& frame = frames.getWriteBuffer();
+            frame.assign(FRAME_WORDS, seq);
+            frames.publish();
+
+            // Lets the two interleave even on a single core
+            if (seq % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+
+    uint64_t last = 0;
+    uint64_t taken = 0;
+    uint64_t failures = 0;
+    auto check = [&]() {
+        if (!frames.update()) {
+            return;
+        }
+
+        const Frame& frame = frames.getReadBuffer();
+        if (frame.size() != FRAME_WORDS) {
+            std::cerr << "frame " << taken << " has " << frame.size() << " words" << std::endl;
+            failures++;
+            return;
+        }
+
+        uint64_t seq = frame.front();
+        for (uint64_t word : frame) {
+            if (word != seq) {
+                std::cerr << "torn frame: " << seq << " and " << word << std::endl;
+                failures++;
+                break;
+            }
+        }
+
+        if (seq <= last) {
+            std::cerr << "stale frame: " << seq << " after " << last << std::endl;
+            failures++;
+        }
+
+        last = seq;
+        taken++;
+    };
+
+    while (!done && failures < 10) {
+        check();
+    }
+    producer.join();
+
+    // Whatever was published last must still come out once the producer stops
+    check();
+    if (last != FRAMES) {
+        std::cerr << "newest frame never handed out, last was " << last << std::endl;
+        failures++;
+    }
+
+    std::cout << taken << " of " << FRAMES << " frames taken, " << failures << " failures" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
+
+#undef FRAMES
+#undef FRAME_WORDS